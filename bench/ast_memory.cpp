@@ -0,0 +1,59 @@
+// AST allocation benchmark: parse time, memory held by the tree, peak RSS
+// and teardown time for one large generated script.
+// Usage: bench_ast_memory [bytes] [corpus]
+#include "corpus.h"
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Resident set size right now, in bytes
+static size_t currentRSS() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+static size_t peakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+int main(int argc, char* argv[]) {
+    size_t targetBytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 32u << 20;
+    std::string name = argc > 2 ? argv[2] : "mixed";
+
+    std::string code;
+    for (const CorpusSpec& spec : corpusSpecs()) {
+        if (name == spec.name) code = spec.generate(targetBytes);
+    }
+    if (code.empty()) {
+        std::cerr << "Error: unknown corpus '" << name << "'" << std::endl;
+        return 1;
+    }
+
+    Parser parser(Lexer(code).tokenizeAll());
+    size_t before = currentRSS();
+
+    auto parseStart = std::chrono::steady_clock::now();
+    std::unique_ptr<Program> program = parser.parseProgram();
+    std::chrono::duration<double, std::milli> parseTime = std::chrono::steady_clock::now() - parseStart;
+    size_t after = currentRSS();
+
+    auto teardownStart = std::chrono::steady_clock::now();
+    program.reset();
+    std::chrono::duration<double, std::milli> teardownTime = std::chrono::steady_clock::now() - teardownStart;
+
+    std::cout << name << ": " << code.size() / 1024 << " KiB, parse " << parseTime.count() << " ms, tree "
+              << (after - before) / 1024 << " KiB resident, teardown " << teardownTime.count() << " ms, peak RSS "
+              << peakRSS() / 1024 << " KiB" << std::endl;
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Tree walking against running the flat program (compiled to bytecode
+// first): re-triggering arithmetic-heavy, print-heavy and mixed-type onClick
+// handlers, then one-shot runs of the generated corpora, compile time
+// included.
+// Printed output goes through the real stdout into /dev/null, so per-line
+// flushing costs what it would in a pipe.
+// Usage: bench_bytecode [handlers] [statements per handler] [rounds]
+#include "corpus.h"
+#include "../src/parser.h"
+#include "tree_walker.h"
+#include "../src/interpreter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static std::string arithmeticHandlers(int handlers, int statements) {
+    std::string code;
+    for (int h = 0; h < handlers; h++) {
+        code += "onClick(\"h" + std::to_string(h) + "\") {\n    let v0 = " + std::to_string(h) + ";\n";
+        for (int s = 1; s < statements; s++) {
+            code += "    let v" + std::to_string(s) + " = (v" + std::to_string(s - 1) + " * 3 + " +
+                    std::to_string(s) + ") - " + std::to_string(s) + " * 2;\n";
+        }
+        code += "}\n";
+    }
+    return code;
+}
+
+static std::string printHandlers(int handlers, int statements) {
+    std::string code;
+    for (int h = 0; h < handlers; h++) {
+        code += "onClick(\"h" + std::to_string(h) + "\") {\n    let total = " + std::to_string(h) + ".5;\n";
+        for (int s = 1; s < statements; s++) {
+            code += "    print(\"item " + std::to_string(s) + ": \" + total * " + std::to_string(s) + ");\n";
+        }
+        code += "}\n";
+    }
+    return code;
+}
+
+// Every statement's operators see one pair of operand types, a different
+// pair from statement to statement: integers, doubles, strings and a
+// string with a number
+static std::string typedHandlers(int handlers, int statements) {
+    std::string code;
+    for (int h = 0; h < handlers; h++) {
+        code += "onClick(\"h" + std::to_string(h) + "\") {\n    let n = " + std::to_string(h) + ";\n    let d = " +
+                std::to_string(h) + ".5;\n    let s = \"k\";\n";
+        for (int s = 0; s < statements; s++) {
+            std::string i = std::to_string(s);
+            switch (s % 4) {
+                case 0: code += "    let a" + i + " = n * 3 + " + i + " - n;\n"; break;
+                case 1: code += "    let a" + i + " = d * " + i + " - d + 0.25;\n"; break;
+                case 2: code += "    let a" + i + " = s + \"x\" + s;\n"; break;
+                case 3: code += "    let a" + i + " = s + d + \"!\";\n"; break;
+            }
+        }
+        code += "}\n";
+    }
+    return code;
+}
+
+// Points stdout at /dev/null for as long as it lives
+class SilencedStdout {
+private:
+    int saved;
+
+public:
+    SilencedStdout() {
+        std::cout.flush();
+        std::fflush(stdout);
+        saved = dup(STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    ~SilencedStdout() {
+        std::cout.flush();
+        std::fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+};
+
+// Best time for one round of triggering every handler on an Engine
+template <typename Engine, typename Register>
+static double handlerRound(int handlers, int rounds, Register registerHandlers) {
+    SilencedStdout silenced;
+    Engine interpreter;
+    registerHandlers(interpreter);
+    std::vector<std::string> ids;
+    for (int h = 0; h < handlers; h++) {
+        ids.push_back("h" + std::to_string(h));
+    }
+    return bestMilliseconds(rounds, [&] {
+        for (const std::string& id : ids) {
+            interpreter.triggerEvent(id);
+        }
+    });
+}
+
+int main(int argc, char* argv[]) {
+    int handlers = argc > 1 ? std::atoi(argv[1]) : 200;
+    int statements = argc > 2 ? std::atoi(argv[2]) : 300;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 10;
+
+    struct HandlerCorpus {
+        const char* name;
+        std::string code;
+    };
+    HandlerCorpus corpora[] = {
+        {"arithmetic handlers", arithmeticHandlers(handlers, statements)},
+        {"print handlers", printHandlers(handlers, statements)},
+        {"typed handlers", typedHandlers(handlers, statements)},
+    };
+    for (const HandlerCorpus& corpus : corpora) {
+        std::unique_ptr<Program> program = Parser(corpus.code).parseProgram();
+        double tree = handlerRound<TreeWalker>(handlers, rounds, [&](TreeWalker& w) { w.interpret(*program); });
+        double flat = handlerRound<Interpreter>(handlers, rounds, [&](Interpreter& i) { i.interpret(program->flat); });
+        std::cout << corpus.name << " (" << handlers << " x " << statements << "): tree " << tree
+                  << " ms per round, flat " << flat << " ms (" << tree / flat << "x)" << std::endl;
+    }
+
+    const char* oneShot[] = {"let_chain", "deep_arithmetic", "mixed"};
+    for (const char* name : oneShot) {
+        std::string code;
+        for (const CorpusSpec& spec : corpusSpecs()) {
+            if (std::string(name) == spec.name) code = spec.generate(4u << 20);
+        }
+        std::unique_ptr<Program> program = Parser(code).parseProgram();
+        double tree, flat;
+        {
+            SilencedStdout silenced;
+            tree = bestMilliseconds(rounds / 2 + 1, [&] { TreeWalker().interpret(*program); });
+            flat = bestMilliseconds(rounds / 2 + 1, [&] { Interpreter().interpret(program->flat); });
+        }
+        std::cout << name << " one-shot (" << program->nodeCount << " nodes): tree " << tree << " ms, flat " << flat
+                  << " ms (" << tree / flat << "x)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Function calls on the bytecode VM: naive recursive fib, mutually
+// recursive isEven/isOdd through tail calls, an accumulating countdown in
+// tail position, and a non-tail recursion 50000 deep. There is no baseline:
+// the tree walker runs no user-defined functions, and the language had no
+// calls before the VM's frames. Each script's result is checked against
+// the same function computed natively, and the time is also given per call.
+// Usage: bench_calls [fib n] [tail calls] [rounds]
+#include "corpus.h"
+#include "../src/parser.h"
+#include "../src/interpreter.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static const char* FUNCTIONS = R"(
+function fib(n) {
+    if (n - 1 - 0) {
+        if (n) { return fib(n - 1) + fib(n - 2); }
+    }
+    return n;
+}
+function isEven(n) { if (n) { return isOdd(n - 1); } return 1; }
+function isOdd(n) { if (n) { return isEven(n - 1); } return 0; }
+function count(n, total) { if (n) { return count(n - 1, total + n); } return total; }
+function depth(n) { if (n) { return 1 + depth(n - 1); } return 0; }
+)";
+
+// The first line running `program` prints
+static std::string output(Program& program) {
+    std::ostringstream out;
+    std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+    Interpreter().interpret(program.flat);
+    std::cout.rdbuf(saved);
+    std::string text = out.str();
+    return text.substr(0, text.find('\n'));
+}
+
+int main(int argc, char* argv[]) {
+    int fib = argc > 1 ? std::atoi(argv[1]) : 25;
+    int tail = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 5;
+    int deep = tail / 20;
+
+    // fib(n) makes fib(n + 1) * 2 - 1 calls in all
+    int64_t fibValue = 0, next = 1;
+    for (int i = 0; i < fib; i++) {
+        next += fibValue;
+        fibValue = next - fibValue;
+    }
+    int64_t fibCalls = next * 2 - 1;
+
+    struct CallCorpus {
+        const char* name;
+        std::string call;
+        int64_t expected;
+        int64_t calls;
+    };
+    CallCorpus corpora[] = {
+        {"fib", "fib(" + std::to_string(fib) + ")", fibValue, fibCalls},
+        {"isEven (mutual tail calls)", "isEven(" + std::to_string(tail) + ")", tail % 2 == 0, tail + 1},
+        {"count (self tail calls)", "count(" + std::to_string(tail) + ", 0)", int64_t(tail) * (tail + 1) / 2, tail + 1},
+        {"depth (non-tail)", "depth(" + std::to_string(deep) + ")", deep, deep + 1},
+    };
+    for (const CallCorpus& corpus : corpora) {
+        std::unique_ptr<Program> program = Parser(std::string(FUNCTIONS) + "print(" + corpus.call + ");\n").parseProgram();
+        std::string result;
+        double flat = bestMilliseconds(rounds, [&] { result = output(*program); });
+        std::cout << corpus.name << " " << corpus.call << " = " << result << ": " << flat << " ms, "
+                  << flat * 1e6 / static_cast<double>(corpus.calls) << " ns per call"
+                  << (result == std::to_string(corpus.expected) ? "" : " MISMATCH") << std::endl;
+    }
+    return 0;
+}
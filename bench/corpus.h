@@ -0,0 +1,119 @@
+// Deterministic synthetic .ks corpora for the benchmarks. The same name and
+// size always produce byte-identical text, so numbers from different commits
+// are comparable. bestMilliseconds is the timing loop the benchmarks share.
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CorpusSpec {
+    const char* name;
+    std::string (*generate)(size_t targetBytes);
+};
+
+// xorshift32: fixed sequence on every platform, unlike std distributions
+class CorpusRandom {
+private:
+    uint32_t state;
+
+public:
+    explicit CorpusRandom(uint32_t seed) : state(seed ? seed : 1) {}
+
+    uint32_t next(uint32_t bound) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state % bound;
+    }
+};
+
+// let v_1 = v_0 + 1; ... every binding reads the one before it
+inline std::string letChainCorpus(size_t targetBytes) {
+    std::string code = "let v_0 = 0;\n";
+    for (size_t i = 1; code.size() < targetBytes; i++) {
+        code += "let v_" + std::to_string(i) + " = v_" + std::to_string(i - 1) + " + " + std::to_string(i % 97) + ";\n";
+    }
+    return code;
+}
+
+// Parenthesised nesting 32 deep, and flat left-associative chains of 128 terms
+inline std::string deepArithmeticCorpus(size_t targetBytes) {
+    static const char OPERATORS[] = {'+', '-', '*'};
+    CorpusRandom random(0xA817);
+    std::string code;
+    for (size_t i = 0; code.size() < targetBytes; i++) {
+        std::string expr = std::to_string(random.next(10) + 1);
+        if (i % 2 == 0) {
+            for (int depth = 0; depth < 32; depth++) {
+                expr = "(" + expr + " " + OPERATORS[random.next(3)] + " " + std::to_string(random.next(10) + 1) + ")";
+            }
+        } else {
+            for (int term = 0; term < 128; term++) {
+                expr += std::string(" ") + OPERATORS[random.next(2)] + " " + std::to_string(random.next(1000)) + ".5";
+            }
+        }
+        code += "let e_" + std::to_string(i) + " = " + expr + ";\n";
+    }
+    return code;
+}
+
+inline std::string onClickCorpus(size_t targetBytes) {
+    std::string code;
+    for (size_t i = 0; code.size() < targetBytes; i++) {
+        std::string n = std::to_string(i);
+        code += "onClick(\"button_" + n + "\") {\n";
+        code += "    let clicks_" + n + " = " + n + " * 2 + 1;\n";
+        code += "    print(\"button " + n + " clicked \" + clicks_" + n + ");\n";
+        code += "}\n";
+    }
+    return code;
+}
+
+// 4 KiB literals; every other one contains escapes so both the zero-copy and
+// the decoding lexer paths are exercised
+inline std::string longStringCorpus(size_t targetBytes) {
+    CorpusRandom random(0x5791);
+    std::string code;
+    for (size_t i = 0; code.size() < targetBytes; i++) {
+        std::string text;
+        while (text.size() < 4096) {
+            text += static_cast<char>('a' + random.next(26));
+            if (random.next(12) == 0) {
+                text += (i % 2 == 0) ? " " : (random.next(2) ? "\\n" : "\\\"");
+            }
+        }
+        code += "let s_" + std::to_string(i) + " = \"" + text + "\";\n";
+    }
+    return code;
+}
+
+inline std::string mixedCorpus(size_t targetBytes) {
+    size_t part = targetBytes / 4;
+    return letChainCorpus(part) + deepArithmeticCorpus(part) + onClickCorpus(part) + longStringCorpus(part);
+}
+
+inline const std::vector<CorpusSpec>& corpusSpecs() {
+    static const std::vector<CorpusSpec> specs = {
+        {"let_chain", letChainCorpus},
+        {"deep_arithmetic", deepArithmeticCorpus},
+        {"onclick_blocks", onClickCorpus},
+        {"long_strings", longStringCorpus},
+        {"mixed", mixedCorpus},
+    };
+    return specs;
+}
+
+// Fastest of `repetitions` runs of fn, in milliseconds
+template <typename Fn>
+inline double bestMilliseconds(int repetitions, Fn&& fn) {
+    double best = 1e300;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
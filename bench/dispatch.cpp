@@ -0,0 +1,228 @@
+// Per-node dispatch overhead: a tree walk through accept()/visit() double
+// dispatch against one switch on the node's kind tag, then the cost per
+// node of the tree walker kept in tree_walker.h on the same corpora.
+// Usage: bench_dispatch [bytes] [repetitions]
+#include "corpus.h"
+#include "tree_walker.h"
+#include "../src/parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class VisitorWalk : public ASTVisitor {
+public:
+    size_t count = 0;
+
+    void visit(NumberLiteral&) override { count++; }
+    void visit(IntegerLiteral&) override { count++; }
+    void visit(StringLiteral&) override { count++; }
+    void visit(Identifier&) override { count++; }
+    void visit(BinaryExpression& node) override {
+        count++;
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(CallExpression& node) override {
+        count++;
+        node.function->accept(*this);
+        for (Expression* arg : node.arguments) arg->accept(*this);
+    }
+    void visit(ExpressionStatement& node) override {
+        count++;
+        node.expression->accept(*this);
+    }
+    void visit(LetStatement& node) override {
+        count++;
+        node.value->accept(*this);
+    }
+    void visit(BlockStatement& node) override {
+        count++;
+        for (Statement* stmt : node.statements) stmt->accept(*this);
+    }
+    void visit(FunctionDeclaration& node) override {
+        count++;
+        node.body->accept(*this);
+    }
+    void visit(OnClickStatement& node) override {
+        count++;
+        node.body->accept(*this);
+    }
+    void visit(ReturnStatement& node) override {
+        count++;
+        if (node.value) node.value->accept(*this);
+    }
+    void visit(IfStatement& node) override {
+        count++;
+        node.condition->accept(*this);
+        node.consequence->accept(*this);
+        if (node.alternative) node.alternative->accept(*this);
+    }
+    void visit(Program& node) override {
+        count++;
+        for (Statement* stmt : node.statements) stmt->accept(*this);
+    }
+};
+
+static size_t switchWalk(ASTNode* node) {
+    switch (node->kind) {
+        case NodeKind::NUMBER:
+        case NodeKind::INTEGER:
+        case NodeKind::STRING:
+        case NodeKind::IDENTIFIER:
+            return 1;
+        case NodeKind::BINARY: {
+            auto* binary = static_cast<BinaryExpression*>(node);
+            return 1 + switchWalk(binary->left) + switchWalk(binary->right);
+        }
+        case NodeKind::CALL: {
+            auto* call = static_cast<CallExpression*>(node);
+            size_t count = 1 + switchWalk(call->function);
+            for (Expression* arg : call->arguments) count += switchWalk(arg);
+            return count;
+        }
+        case NodeKind::EXPRESSION_STATEMENT:
+            return 1 + switchWalk(static_cast<ExpressionStatement*>(node)->expression);
+        case NodeKind::LET:
+            return 1 + switchWalk(static_cast<LetStatement*>(node)->value);
+        case NodeKind::BLOCK: {
+            size_t count = 1;
+            for (Statement* stmt : static_cast<BlockStatement*>(node)->statements) count += switchWalk(stmt);
+            return count;
+        }
+        case NodeKind::FUNCTION:
+            return 1 + switchWalk(static_cast<FunctionDeclaration*>(node)->body);
+        case NodeKind::ONCLICK:
+            return 1 + switchWalk(static_cast<OnClickStatement*>(node)->body);
+        case NodeKind::RETURN: {
+            auto* ret = static_cast<ReturnStatement*>(node);
+            return 1 + (ret->value ? switchWalk(ret->value) : 0);
+        }
+        case NodeKind::IF: {
+            auto* branch = static_cast<IfStatement*>(node);
+            return 1 + switchWalk(branch->condition) + switchWalk(branch->consequence) +
+                   (branch->alternative ? switchWalk(branch->alternative) : 0);
+        }
+        case NodeKind::PROGRAM: {
+            size_t count = 1;
+            for (Statement* stmt : static_cast<Program*>(node)->statements) count += switchWalk(stmt);
+            return count;
+        }
+    }
+    return 0;
+}
+
+// Callee of every call in the tree, for timing the "is it print?" check
+static void collectCallees(ASTNode* node, std::vector<Expression*>& callees) {
+    switch (node->kind) {
+        case NodeKind::BINARY:
+            collectCallees(static_cast<BinaryExpression*>(node)->left, callees);
+            collectCallees(static_cast<BinaryExpression*>(node)->right, callees);
+            break;
+        case NodeKind::CALL:
+            callees.push_back(static_cast<CallExpression*>(node)->function);
+            for (Expression* arg : static_cast<CallExpression*>(node)->arguments) collectCallees(arg, callees);
+            break;
+        case NodeKind::EXPRESSION_STATEMENT:
+            collectCallees(static_cast<ExpressionStatement*>(node)->expression, callees);
+            break;
+        case NodeKind::LET:
+            collectCallees(static_cast<LetStatement*>(node)->value, callees);
+            break;
+        case NodeKind::BLOCK:
+            for (Statement* stmt : static_cast<BlockStatement*>(node)->statements) collectCallees(stmt, callees);
+            break;
+        case NodeKind::ONCLICK:
+            collectCallees(static_cast<OnClickStatement*>(node)->body, callees);
+            break;
+        case NodeKind::PROGRAM:
+            for (Statement* stmt : static_cast<Program*>(node)->statements) collectCallees(stmt, callees);
+            break;
+        default:
+            break;
+    }
+}
+
+template <typename Fn>
+static double bestNanosPerNode(int repetitions, size_t nodes, Fn&& fn) {
+    double best = 1e300;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best / nodes;
+}
+
+int main(int argc, char* argv[]) {
+    size_t targetBytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4u << 20;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    // dynamic_cast<Identifier*> on each callee, as the interpreter used to
+    // do per call, against comparing the kind tag. The empty asm keeps the
+    // compiler from folding either loop away.
+    {
+        std::string code = onClickCorpus(targetBytes);
+        Parser parser(code);
+        std::unique_ptr<Program> program = parser.parseProgram();
+        std::vector<Expression*> callees;
+        collectCallees(program.get(), callees);
+        size_t found = 0;
+        double cast = bestNanosPerNode(repetitions, callees.size(), [&] {
+            found = 0;
+            for (Expression* callee : callees) {
+                auto* ident = dynamic_cast<Identifier*>(callee);
+                found += ident && ident->name == SYMBOL_PRINT;
+                asm volatile("" : "+r"(found));
+            }
+        });
+        double tag = bestNanosPerNode(repetitions, callees.size(), [&] {
+            found = 0;
+            for (Expression* callee : callees) {
+                found += callee->kind == NodeKind::IDENTIFIER && static_cast<Identifier*>(callee)->name == SYMBOL_PRINT;
+                asm volatile("" : "+r"(found));
+            }
+        });
+        std::cout << "print check on " << found << " callees: dynamic_cast " << cast << " ns, kind tag " << tag
+                  << " ns" << std::endl;
+    }
+
+    const char* corpora[] = {"let_chain", "deep_arithmetic", "mixed"};
+    for (const char* name : corpora) {
+        std::string code;
+        for (const CorpusSpec& spec : corpusSpecs()) {
+            if (std::string(name) == spec.name) code = spec.generate(targetBytes);
+        }
+        Parser parser(code);
+        std::unique_ptr<Program> program = parser.parseProgram();
+        size_t nodes = program->nodeCount;
+
+        size_t visited = 0;
+        double visitor = bestNanosPerNode(repetitions, nodes, [&] {
+            VisitorWalk walk;
+            program->accept(walk);
+            visited = walk.count;
+        });
+        double tagged = bestNanosPerNode(repetitions, nodes, [&] { visited = switchWalk(program.get()); });
+        if (visited != nodes) {
+            std::cerr << "Error: walked " << visited << " of " << nodes << " nodes" << std::endl;
+            return 1;
+        }
+
+        std::ostringstream sink;
+        std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+        double interpret = bestNanosPerNode(repetitions, nodes, [&] {
+            TreeWalker walker;
+            walker.interpret(*program);
+        });
+        std::cout.rdbuf(saved);
+
+        std::cout << name << ": " << nodes << " nodes; walk ns/node visitor " << visitor << ", switch " << tagged
+                  << "; tree interpreter " << interpret << " ns/node" << std::endl;
+    }
+    return 0;
+}
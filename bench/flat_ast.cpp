@@ -0,0 +1,121 @@
+// Pointer tree vs flat AST: time to re-execute many large onClick handler
+// bodies, walked by tree_walker.h or compiled from the flat AST, plus
+// hardware cache misses where perf counters are available.
+// Usage: bench_flat_ast [handlers] [statements per handler] [rounds]
+#include "tree_walker.h"
+#include "../src/parser.h"
+#include "../src/interpreter.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sstream>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static std::string handlerCorpus(int handlers, int statements) {
+    std::string code;
+    for (int h = 0; h < handlers; h++) {
+        code += "onClick(\"h" + std::to_string(h) + "\") {\n    let v0 = " + std::to_string(h) + ";\n";
+        for (int s = 1; s < statements; s++) {
+            code += "    let v" + std::to_string(s) + " = (v" + std::to_string(s - 1) + " * 3 + " +
+                    std::to_string(s) + ") - " + std::to_string(s) + " * 2;\n";
+        }
+        code += "}\n";
+    }
+    return code;
+}
+
+// Counts last-level cache misses for the calling thread; -1 if the kernel
+// or machine does not expose hardware counters
+class CacheMissCounter {
+private:
+    int fd;
+
+public:
+    CacheMissCounter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~CacheMissCounter() {
+        if (fd >= 0) close(fd);
+    }
+
+    void start() {
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    long long stop() {
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+        return count;
+    }
+};
+
+template <typename Engine, typename Register>
+static void measure(const char* label, int handlers, int rounds, Register registerHandlers) {
+    std::ostringstream sink;
+    std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+    Engine interpreter;
+    registerHandlers(interpreter);
+    std::cout.rdbuf(saved);
+
+    std::vector<std::string> ids;
+    for (int h = 0; h < handlers; h++) {
+        ids.push_back("h" + std::to_string(h));
+    }
+
+    CacheMissCounter misses;
+    misses.start();
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const std::string& id : ids) {
+            interpreter.triggerEvent(id);
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    long long missCount = misses.stop();
+
+    std::cout << label << ": " << elapsed.count() / rounds << " ms per round, cache misses "
+              << (missCount < 0 ? std::string("unavailable") : std::to_string(missCount / rounds) + " per round")
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int handlers = argc > 1 ? std::atoi(argv[1]) : 200;
+    int statements = argc > 2 ? std::atoi(argv[2]) : 300;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    std::string code = handlerCorpus(handlers, statements);
+    Parser parser(code);
+    std::unique_ptr<Program> program = parser.parseProgram();
+    if (!parser.getErrors().empty()) {
+        std::cerr << "Error: " << parser.getErrors()[0] << std::endl;
+        return 1;
+    }
+    if (program->toString() != program->flat.toString()) {
+        std::cerr << "Error: flat AST does not print the same as the tree" << std::endl;
+        return 1;
+    }
+
+    std::cout << handlers << " handlers x " << statements << " statements, " << program->flat.size()
+              << " nodes; tree arena " << program->arena.bytesUsed() / 1024 << " KiB, flat "
+              << program->flat.memoryUsage() / 1024 << " KiB" << std::endl;
+
+    measure<TreeWalker>("tree", handlers, rounds, [&](TreeWalker& walker) { walker.interpret(*program); });
+    measure<Interpreter>("flat", handlers, rounds, [&](Interpreter& interpreter) { interpreter.interpret(program->flat); });
+    return 0;
+}
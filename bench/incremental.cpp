@@ -0,0 +1,66 @@
+// Incremental re-lexing benchmark: per-keystroke latency against a full
+// re-lex, as the file grows. Keystrokes come in bursts at random positions;
+// the first edit of a burst ("jump") also moves the gap buffers there.
+// Usage: bench_incremental [bursts]
+#include "../src/lexer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::string syntheticInput(size_t targetBytes) {
+    std::string code;
+    for (size_t i = 0; code.size() < targetBytes; i++) {
+        std::string n = std::to_string(i);
+        code += "let value_" + n + " = (a + " + n + ") * 2.5;\n";
+        code += "onClick(\"button" + n + "\") { print(\"clicked " + n + "\"); }\n";
+    }
+    return code;
+}
+
+static double percentile(std::vector<double> samples, double p) {
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<size_t>(p * (samples.size() - 1))];
+}
+
+int main(int argc, char* argv[]) {
+    int bursts = argc > 1 ? std::atoi(argv[1]) : 200;
+    size_t sizes[] = {64 * 1024, 1024 * 1024, 8 * 1024 * 1024, 32 * 1024 * 1024};
+    std::mt19937 rng(1234);
+    
+    for (size_t size : sizes) {
+        std::string code = syntheticInput(size);
+        IncrementalLexer lexer(code);
+        
+        auto fullStart = std::chrono::steady_clock::now();
+        TokenStream full = Lexer(code).tokenizeAll();
+        std::chrono::duration<double, std::micro> fullTime = std::chrono::steady_clock::now() - fullStart;
+        
+        // Each burst jumps to a random spot, types "abc" and deletes it again
+        std::vector<double> jumps;
+        std::vector<double> keystrokes;
+        size_t relexed = 0;
+        for (int b = 0; b < bursts; b++) {
+            size_t offset = rng() % code.size();
+            for (int k = 0; k < 6; k++) {
+                auto start = std::chrono::steady_clock::now();
+                if (k < 3) {
+                    relexed += lexer.edit(offset + k, 0, std::string_view("abc" + k, 1));
+                } else {
+                    relexed += lexer.edit(offset + 5 - k, 1, "");
+                }
+                std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                (k == 0 ? jumps : keystrokes).push_back(elapsed.count());
+            }
+        }
+        
+        std::cout << code.size() / 1024 << " KiB, " << full.size() << " tokens: full re-lex "
+                  << static_cast<long>(fullTime.count()) << " us; keystroke p50 " << percentile(keystrokes, 0.5)
+                  << " us, p99 " << percentile(keystrokes, 0.99) << " us; jump p50 " << percentile(jumps, 0.5)
+                  << " us; " << static_cast<double>(relexed) / (bursts * 6) << " tokens re-lexed per edit" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Lexer microbenchmark: tokens/sec for each character-scanning path on the
+// same input. Usage: bench_lexer_scan [file.ks] [repetitions]
+#include "../src/charscan.h"
+#include "../src/lexer.h"
+#include "../src/source.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static std::string syntheticInput() {
+    std::string code;
+    for (int i = 0; i < 20000; i++) {
+        std::string n = std::to_string(i);
+        code += "    let identifier_number_" + n + " = " + n + "1234.5 + previous_value_" + n + ";\n";
+        code += "        print(\"a reasonably long string literal for handler " + n + "\");\n";
+        code += "\n        // comment line " + n + "\n";
+    }
+    return code;
+}
+
+int main(int argc, char* argv[]) {
+    SourceBuffer source;
+    if (argc > 1) {
+        if (!source.loadFile(argv[1])) {
+            std::cerr << "Error: Could not open file '" << argv[1] << "'" << std::endl;
+            return 1;
+        }
+    } else {
+        source.assign(syntheticInput());
+    }
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 20;
+    
+    std::cout << "input: " << source.size() << " bytes" << std::endl;
+    
+    ScanMode modes[] = {ScanMode::SCALAR, ScanMode::SSE2, ScanMode::AVX2};
+    for (ScanMode mode : modes) {
+        if (!setScanMode(mode)) {
+            std::cout << scanModeName(mode) << ": not supported on this CPU" << std::endl;
+            continue;
+        }
+        
+        size_t tokens = 0;
+        double best = 1e300;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = std::chrono::steady_clock::now();
+            Lexer lexer(source.view());
+            tokens = 0;
+            while (lexer.nextToken().type != TokenType::END_OF_FILE) {
+                tokens++;
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        
+        std::cout << scanModeName(mode) << ": " << tokens << " tokens, "
+                  << static_cast<long long>(tokens / best) << " tokens/s, "
+                  << source.size() / best / 1e6 << " MB/s" << std::endl;
+    }
+    return 0;
+}
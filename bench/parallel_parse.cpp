@@ -0,0 +1,75 @@
+// Multi-file parse scaling: writes a project of generated scripts to a
+// temporary directory, then times loading, lexing and parsing all of them
+// on 1..N threads, plus the merge into one program.
+// Usage: bench_parallel_parse [files] [bytes per file] [max threads] [repetitions]
+#include "corpus.h"
+#include "../src/project.h"
+#include "../src/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    size_t fileCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    size_t bytesPerFile = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256u << 10;
+    unsigned maxThreads = argc > 3 ? std::atoi(argv[3]) : std::max(ThreadPool::hardwareThreads(), 4u);
+    int repetitions = argc > 4 ? std::atoi(argv[4]) : 5;
+
+    char directory[] = "/tmp/karou_parallel_XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const std::vector<CorpusSpec>& specs = corpusSpecs();
+    std::vector<std::string> paths;
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < fileCount; i++) {
+        // Sizes vary from half to one and a half times the average, so the
+        // scheduler has uneven work to balance
+        size_t bytes = bytesPerFile / 2 + bytesPerFile * (i % 5) / 4;
+        std::string code = specs[i % specs.size()].generate(bytes);
+        paths.push_back(std::string(directory) + "/file" + std::to_string(i) + ".ks");
+        std::ofstream(paths.back(), std::ios::binary) << code;
+        totalBytes += code.size();
+    }
+
+    std::cout << fileCount << " files, " << totalBytes << " bytes, " << ThreadPool::hardwareThreads()
+              << " hardware threads" << std::endl;
+    double baseline = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads++) {
+        double parse = 1e300;
+        double merge = 1e300;
+        for (int r = 0; r < repetitions; r++) {
+            std::vector<SourceFile> files(paths.size());
+            for (size_t i = 0; i < paths.size(); i++) {
+                files[i].path = paths[i];
+            }
+            SourceMap sources;
+            auto start = std::chrono::steady_clock::now();
+            parseFiles(files, sources, threads);
+            auto parsed = std::chrono::steady_clock::now();
+            std::unique_ptr<Program> program = mergePrograms(files);
+            std::chrono::duration<double, std::milli> parseTime = parsed - start;
+            std::chrono::duration<double, std::milli> mergeTime = std::chrono::steady_clock::now() - parsed;
+            parse = std::min(parse, parseTime.count());
+            merge = std::min(merge, mergeTime.count());
+        }
+        if (threads == 1) {
+            baseline = parse;
+        }
+        std::cout << threads << " threads: parse " << parse << " ms (" << totalBytes / parse / 1000 << " MB/s, "
+                  << baseline / parse << "x), merge " << merge << " ms" << std::endl;
+    }
+
+    for (const std::string& path : paths) {
+        unlink(path.c_str());
+    }
+    rmdir(directory);
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Lex / parse / execute throughput over the synthetic corpora in corpus.h.
+// Each phase is timed on its own and the result is written as JSON, so runs
+// from two commits can be diffed directly.
+// Usage: bench_throughput [--reps N] [--size BYTES] [--label TEXT]
+//                         [--only NAME] [--emit DIR]
+#include "corpus.h"
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "../src/interpreter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct PhaseTimes {
+    std::vector<double> seconds;
+
+    double percentile(double p) const {
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[static_cast<size_t>(p * (sorted.size() - 1) + 0.5)];
+    }
+};
+
+template <typename Fn>
+static double timed(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// {"ms": {...}, "mb_per_s": ..., ...} with rates taken at the median
+static void writePhase(std::ostream& out, const char* name, const PhaseTimes& times, size_t bytes,
+                       size_t tokens, size_t nodes) {
+    double median = times.percentile(0.5);
+    out << "      \"" << name << "\": {\"ms\": {\"min\": " << times.percentile(0.0) * 1e3
+        << ", \"p50\": " << median * 1e3 << ", \"p90\": " << times.percentile(0.9) * 1e3
+        << ", \"p99\": " << times.percentile(0.99) * 1e3 << "}";
+    if (bytes) out << ", \"mb_per_s\": " << bytes / median / 1e6;
+    if (tokens) out << ", \"tokens_per_s\": " << static_cast<long long>(tokens / median);
+    if (nodes) out << ", \"nodes_per_s\": " << static_cast<long long>(nodes / median);
+    out << "}";
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = 15;
+    size_t targetBytes = 1 << 20;
+    std::string label;
+    std::string only;
+    std::string emitDir;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--reps") {
+            repetitions = std::max(1, std::atoi(argv[++i]));
+        } else if (i + 1 < argc && arg == "--size") {
+            targetBytes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && arg == "--label") {
+            label = argv[++i];
+        } else if (i + 1 < argc && arg == "--only") {
+            only = argv[++i];
+        } else if (i + 1 < argc && arg == "--emit") {
+            emitDir = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--reps N] [--size BYTES] [--label TEXT] [--only NAME] [--emit DIR]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Write the corpora out as .ks files instead of measuring them
+    if (!emitDir.empty()) {
+        for (const CorpusSpec& spec : corpusSpecs()) {
+            if (!only.empty() && only != spec.name) continue;
+            std::string path = emitDir + "/" + spec.name + ".ks";
+            std::ofstream file(path, std::ios::binary);
+            file << spec.generate(targetBytes);
+            if (!file) {
+                std::cerr << "Error: Could not write '" << path << "'" << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    std::cout << "{\n  \"label\": \"" << label << "\",\n  \"repetitions\": " << repetitions
+              << ",\n  \"corpora\": [";
+    bool first = true;
+    for (const CorpusSpec& spec : corpusSpecs()) {
+        if (!only.empty() && only != spec.name) continue;
+        std::string code = spec.generate(targetBytes);
+
+        PhaseTimes lex, parse, execute;
+        size_t tokens = 0;
+        size_t nodes = 0;
+        for (int r = 0; r < repetitions; r++) {
+            TokenStream stream;
+            lex.seconds.push_back(timed([&] { stream = Lexer(code).tokenizeAll(); }));
+            tokens = stream.size();
+
+            // The parser takes ownership of the stream, so parsing is timed
+            // without lexing in it
+            Parser parser(std::move(stream));
+            std::unique_ptr<Program> program;
+            parse.seconds.push_back(timed([&] { program = parser.parseProgram(); }));
+            if (!parser.getErrors().empty()) {
+                std::cerr << "Error: corpus '" << spec.name << "' failed to parse: " << parser.getErrors()[0] << std::endl;
+                return 1;
+            }
+            nodes = program->nodeCount;
+
+            // Discard print() and handler-registration output
+            std::ostringstream sink;
+            std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+            Interpreter interpreter;
+            execute.seconds.push_back(timed([&] { interpreter.interpret(program->flat); }));
+            std::cout.rdbuf(saved);
+        }
+
+        std::cout << (first ? "\n" : ",\n") << "    {\"name\": \"" << spec.name << "\", \"bytes\": " << code.size()
+                  << ", \"tokens\": " << tokens << ", \"nodes\": " << nodes << ",\n";
+        writePhase(std::cout, "lex", lex, code.size(), tokens, 0);
+        std::cout << ",\n";
+        writePhase(std::cout, "parse", parse, code.size(), tokens, nodes);
+        std::cout << ",\n";
+        writePhase(std::cout, "execute", execute, 0, 0, nodes);
+        std::cout << "}";
+        first = false;
+    }
+    std::cout << "\n  ]\n}" << std::endl;
+    return 0;
+}
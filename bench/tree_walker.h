@@ -0,0 +1,218 @@
+// The tree-walking interpreter Karou ran before the bytecode VM, frozen as
+// the baseline the benchmarks measure the VM against. Nothing in karou
+// uses it. It keeps the costs the VM removed: a heap-allocated scope per
+// block, names looked up through chains of hash maps, undefined names
+// reported by exception, and values that copy their strings. It runs no
+// user-defined functions, and statements added to the language after it
+// are skipped.
+#pragma once
+#include "../src/ast.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <variant>
+
+class TreeWalker {
+private:
+    using Value = std::variant<double, std::string, bool, int64_t>;
+
+    class Scope {
+    private:
+        std::unordered_map<Symbol, Value> variables;
+        std::shared_ptr<Scope> parent;
+
+    public:
+        explicit Scope(std::shared_ptr<Scope> parent = nullptr) : parent(std::move(parent)) {}
+
+        void define(Symbol name, const Value& value) { variables[name] = value; }
+
+        Value get(Symbol name) {
+            auto it = variables.find(name);
+            if (it != variables.end()) {
+                return it->second;
+            }
+            if (parent) {
+                return parent->get(name);
+            }
+            throw std::runtime_error("Undefined variable: " + std::string(symbols().name(name)));
+        }
+    };
+
+    std::shared_ptr<Scope> environment = std::make_shared<Scope>();
+    Value lastValue;
+    std::unordered_map<Symbol, std::function<void()>> eventHandlers;
+
+public:
+    void interpret(Program& program) { evaluate(program); }
+
+    void triggerEvent(const std::string& elementId) {
+        auto it = eventHandlers.find(symbols().find(elementId));
+        if (it != eventHandlers.end()) {
+            it->second();
+        }
+    }
+
+private:
+    void evaluate(ASTNode& node) {
+        switch (node.kind) {
+            case NodeKind::NUMBER: lastValue = static_cast<NumberLiteral&>(node).value; break;
+            case NodeKind::INTEGER: lastValue = static_cast<IntegerLiteral&>(node).value; break;
+            case NodeKind::STRING: lastValue = std::string(static_cast<StringLiteral&>(node).value); break;
+            case NodeKind::IDENTIFIER: visit(static_cast<Identifier&>(node)); break;
+            case NodeKind::BINARY: visit(static_cast<BinaryExpression&>(node)); break;
+            case NodeKind::CALL: visit(static_cast<CallExpression&>(node)); break;
+            case NodeKind::EXPRESSION_STATEMENT: evaluate(*static_cast<ExpressionStatement&>(node).expression); break;
+            case NodeKind::LET: visit(static_cast<LetStatement&>(node)); break;
+            case NodeKind::BLOCK: visit(static_cast<BlockStatement&>(node)); break;
+            case NodeKind::FUNCTION:
+                std::cout << "Function '" << symbols().name(static_cast<FunctionDeclaration&>(node).name)
+                          << "' declared (not yet executable)\n";
+                break;
+            case NodeKind::ONCLICK: visit(static_cast<OnClickStatement&>(node)); break;
+            case NodeKind::RETURN:
+            case NodeKind::IF:
+                break;  // newer than this baseline
+            case NodeKind::PROGRAM:
+                for (Statement* stmt : static_cast<Program&>(node).statements) {
+                    evaluate(*stmt);
+                }
+                break;
+        }
+    }
+
+    void visit(Identifier& node) {
+        try {
+            lastValue = environment->get(node.name);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Runtime error: " << e.what() << std::endl;
+            lastValue = 0.0;
+        }
+    }
+
+    void visit(BinaryExpression& node) {
+        evaluate(*node.left);
+        Value leftVal = lastValue;
+        evaluate(*node.right);
+        Value rightVal = lastValue;
+        if (!binaryOperation(node.operator_, leftVal, rightVal, lastValue)) {
+            std::cerr << "Runtime error: Division by zero" << std::endl;
+            lastValue = 0.0;
+        }
+    }
+
+    void visit(CallExpression& node) {
+        if (node.function->kind == NodeKind::IDENTIFIER &&
+            static_cast<Identifier*>(node.function)->name == SYMBOL_PRINT) {
+            if (!node.arguments.empty()) {
+                evaluate(*node.arguments[0]);
+                std::cout << valueToString(lastValue) << '\n';
+            }
+            lastValue = 0.0;  // print returns nothing
+            return;
+        }
+        std::cerr << "Runtime error: Function calls not yet supported" << std::endl;
+        lastValue = 0.0;
+    }
+
+    void visit(LetStatement& node) {
+        evaluate(*node.value);
+        environment->define(node.name, lastValue);
+    }
+
+    void visit(BlockStatement& node) {
+        auto previousEnv = environment;
+        environment = std::make_shared<Scope>(environment);
+        for (Statement* stmt : node.statements) {
+            evaluate(*stmt);
+        }
+        environment = previousEnv;
+    }
+
+    void visit(OnClickStatement& node) {
+        eventHandlers[node.elementId] = [this, &node]() { evaluate(*node.body); };
+        std::cout << "Event handler registered for element: " << symbols().name(node.elementId) << '\n';
+    }
+
+    static bool binaryOperation(BinaryOperator op, const Value& leftVal, const Value& rightVal, Value& result) {
+        // Integer fast path; falls through to double arithmetic on overflow
+        // and for divisions that are not exact
+        if (std::holds_alternative<int64_t>(leftVal) && std::holds_alternative<int64_t>(rightVal)) {
+            int64_t a = std::get<int64_t>(leftVal);
+            int64_t b = std::get<int64_t>(rightVal);
+            int64_t exact;
+            bool overflow = true;
+            switch (op) {
+                case BinaryOperator::ADD: overflow = __builtin_add_overflow(a, b, &exact); break;
+                case BinaryOperator::SUBTRACT: overflow = __builtin_sub_overflow(a, b, &exact); break;
+                case BinaryOperator::MULTIPLY: overflow = __builtin_mul_overflow(a, b, &exact); break;
+                case BinaryOperator::DIVIDE:
+                    overflow = b == 0 || (a == INT64_MIN && b == -1) || a % b != 0;
+                    exact = overflow ? 0 : a / b;
+                    break;
+            }
+            if (!overflow) {
+                result = exact;
+                return true;
+            }
+        }
+
+        switch (op) {
+            case BinaryOperator::ADD:
+                if (std::holds_alternative<std::string>(leftVal) || std::holds_alternative<std::string>(rightVal)) {
+                    result = valueToString(leftVal) + valueToString(rightVal);
+                } else {
+                    result = valueToNumber(leftVal) + valueToNumber(rightVal);
+                }
+                break;
+            case BinaryOperator::SUBTRACT:
+                result = valueToNumber(leftVal) - valueToNumber(rightVal);
+                break;
+            case BinaryOperator::MULTIPLY:
+                result = valueToNumber(leftVal) * valueToNumber(rightVal);
+                break;
+            case BinaryOperator::DIVIDE: {
+                double rightNum = valueToNumber(rightVal);
+                if (rightNum == 0.0) {
+                    return false;
+                }
+                result = valueToNumber(leftVal) / rightNum;
+                break;
+            }
+        }
+        return true;
+    }
+
+    static std::string valueToString(const Value& value) {
+        if (const std::string* text = std::get_if<std::string>(&value)) {
+            return *text;
+        } else if (const double* number = std::get_if<double>(&value)) {
+            // Remove trailing zeros for cleaner output
+            std::string str = std::to_string(*number);
+            str.erase(str.find_last_not_of('0') + 1, std::string::npos);
+            str.erase(str.find_last_not_of('.') + 1, std::string::npos);
+            return str;
+        } else if (const bool* flag = std::get_if<bool>(&value)) {
+            return *flag ? "true" : "false";
+        }
+        return std::to_string(std::get<int64_t>(value));
+    }
+
+    static double valueToNumber(const Value& value) {
+        if (const double* number = std::get_if<double>(&value)) {
+            return *number;
+        } else if (const std::string* text = std::get_if<std::string>(&value)) {
+            try {
+                return std::stod(*text);
+            } catch (...) {
+                return 0.0;
+            }
+        } else if (const bool* flag = std::get_if<bool>(&value)) {
+            return *flag ? 1.0 : 0.0;
+        }
+        return static_cast<double>(std::get<int64_t>(value));
+    }
+};
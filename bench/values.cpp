@@ -0,0 +1,140 @@
+// Value representation on string-heavy scripts: examples/hello.ks scaled
+// up, run once at top level and re-run as onClick handlers. Reports
+// sizeof(Value), heap allocations and bytes while running, heap still held
+// afterwards (globals and the strings they keep alive), and time. Printed
+// output is formatted and then discarded.
+// Usage: bench_values [copies] [rounds]
+#include "corpus.h"
+#include "../src/parser.h"
+#include "../src/interpreter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <streambuf>
+#include <string>
+
+// Every allocation in the process goes through these, so the heap a run
+// uses can be read off before and after it
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+static size_t liveBytes = 0;
+
+void* operator new(size_t size) {
+    size_t* block = static_cast<size_t*>(std::malloc(size + sizeof(size_t)));
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    allocations++;
+    allocatedBytes += size;
+    liveBytes += size;
+    return block + 1;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (!pointer) return;
+    size_t* block = static_cast<size_t*>(pointer) - 1;
+    liveBytes -= *block;
+    std::free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// hello.ks, once per copy, each with its own names. `prefix` goes before
+// every statement, so handler bodies can be indented.
+static std::string helloScaled(int copies, int first, const std::string& prefix) {
+    std::string code;
+    for (int i = first; i < first + copies; i++) {
+        std::string n = std::to_string(i);
+        code += prefix + "print(\"Hello, Karou Script!\");\n";
+        code += prefix + "let x" + n + " = " + std::to_string(i % 100) + ";\n";
+        code += prefix + "let y" + n + " = 20;\n";
+        code += prefix + "let sum" + n + " = x" + n + " + y" + n + ";\n";
+        code += prefix + "print(\"Sum: \" + sum" + n + ");\n";
+        code += prefix + "let name" + n + " = \"Karou\";\n";
+        code += prefix + "let greeting" + n + " = \"Hello, \" + name" + n + " + \"!\";\n";
+        code += prefix + "let banner" + n + " = greeting" + n + " + \" Welcome to the event-driven web.\";\n";
+        code += prefix + "let copy" + n + " = banner" + n + ";\n";
+        code += prefix + "print(copy" + n + ");\n";
+    }
+    return code;
+}
+
+struct HeapUse {
+    size_t allocations;
+    size_t bytes;
+};
+
+template <typename Fn>
+static HeapUse measureHeap(Fn&& fn) {
+    size_t startAllocations = allocations;
+    size_t startBytes = allocatedBytes;
+    fn();
+    return {allocations - startAllocations, allocatedBytes - startBytes};
+}
+
+int main(int argc, char* argv[]) {
+    int copies = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    NullBuffer discard;
+    std::streambuf* stdoutBuffer = std::cout.rdbuf();
+    std::cout << "sizeof(Value) " << sizeof(Value) << " bytes" << std::endl;
+
+    // Top level: every binding is a global the interpreter keeps
+    std::unique_ptr<Program> program = Parser(helloScaled(copies, 0, "")).parseProgram();
+    double oneShot;
+    HeapUse run;
+    size_t held;
+    {
+        std::cout.rdbuf(&discard);
+        oneShot = bestMilliseconds(rounds, [&] { Interpreter().interpret(program->flat); });
+        Interpreter interpreter;
+        Chunk& chunk = interpreter.compile(program->flat);
+        size_t before = liveBytes;
+        run = measureHeap([&] { interpreter.run(chunk); });
+        held = liveBytes - before;
+        std::cout.rdbuf(stdoutBuffer);
+    }
+    std::cout << "hello.ks x " << copies << " at top level: " << oneShot << " ms compile and run, " << run.allocations
+              << " allocations (" << run.bytes / 1024 << " KiB) running, " << held / 1024
+              << " KiB held after" << std::endl;
+
+    // The same statements as handler bodies, 100 copies each, re-run
+    int handlers = std::max(copies / 100, 1);
+    std::string code;
+    for (int h = 0; h < handlers; h++) {
+        code += "onClick(\"h" + std::to_string(h) + "\") {\n" + helloScaled(100, h * 100, "    ") + "}\n";
+    }
+    program = Parser(code).parseProgram();
+    double perRound;
+    HeapUse round;
+    {
+        std::cout.rdbuf(&discard);
+        Interpreter interpreter;
+        interpreter.interpret(program->flat);
+        std::vector<std::string> ids;
+        for (int h = 0; h < handlers; h++) {
+            ids.push_back("h" + std::to_string(h));
+        }
+        auto trigger = [&] {
+            for (const std::string& id : ids) {
+                interpreter.triggerEvent(id);
+            }
+        };
+        perRound = bestMilliseconds(rounds, trigger);
+        round = measureHeap(trigger);
+        std::cout.rdbuf(stdoutBuffer);
+    }
+    std::cout << "hello.ks x " << handlers * 100 << " in " << handlers << " handlers: " << perRound
+              << " ms per round, " << round.allocations << " allocations (" << round.bytes / 1024
+              << " KiB) per round" << std::endl;
+    return 0;
+}
@@ -7,16 +7,27 @@ mkdir -p obj bin
 
 # Compile all source files
 echo "Compiling source files..."
-g++ -std=c++17 -Wall -Wextra -O2 -c src/token.cpp -o obj/token.o
-g++ -std=c++17 -Wall -Wextra -O2 -c src/lexer.cpp -o obj/lexer.o
-g++ -std=c++17 -Wall -Wextra -O2 -c src/ast.cpp -o obj/ast.o
-g++ -std=c++17 -Wall -Wextra -O2 -c src/parser.cpp -o obj/parser.o
-g++ -std=c++17 -Wall -Wextra -O2 -c src/interpreter.cpp -o obj/interpreter.o
-g++ -std=c++17 -Wall -Wextra -O2 -c src/compiler.cpp -o obj/compiler.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/token.cpp -o obj/token.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/source.cpp -o obj/source.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/charscan.cpp -o obj/charscan.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/lexer.cpp -o obj/lexer.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/arena.cpp -o obj/arena.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/symbol.cpp -o obj/symbol.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/ast.cpp -o obj/ast.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/cache.cpp -o obj/cache.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/flat_ast.cpp -o obj/flat_ast.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/parser.cpp -o obj/parser.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/value.cpp -o obj/value.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/bytecode.cpp -o obj/bytecode.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/interpreter.cpp -o obj/interpreter.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/optimizer.cpp -o obj/optimizer.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/thread_pool.cpp -o obj/thread_pool.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/project.cpp -o obj/project.o
+g++ -std=c++17 -Wall -Wextra -O2 -pthread -c src/compiler.cpp -o obj/compiler.o
 
 # Link executable
 echo "Linking executable..."
-if g++ obj/*.o -o bin/karou; then
+if g++ -pthread obj/*.o -o bin/karou; then
     echo "✅ Build successful! Executable created at bin/karou"
     echo ""
     echo "Usage examples:"
@@ -0,0 +1,39 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+Arena::~Arena() {
+    while (head) {
+        Block* next = head->next;
+        std::free(head);
+        head = next;
+    }
+}
+
+void Arena::grow(size_t minimum) {
+    // Blocks double up to MAX_BLOCK_SIZE, so a tree of any size needs only
+    // a handful of mallocs; oversized requests get a block of their own
+    size_t capacity = std::max(nextBlockSize, minimum);
+    nextBlockSize = std::min(nextBlockSize * 2, MAX_BLOCK_SIZE);
+
+    Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + capacity));
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    block->next = head;
+    block->capacity = capacity;
+    head = block;
+    cursor = reinterpret_cast<char*>(block + 1);
+    limit = cursor + capacity;
+    bytesReserved_ += capacity;
+}
+
+std::string_view Arena::copyString(std::string_view text) {
+    if (text.empty()) {
+        return std::string_view();
+    }
+    char* storage = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(storage, text.data(), text.size());
+    return std::string_view(storage, text.size());
+}
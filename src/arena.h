@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * ArenaArray is a fixed-length view of elements stored in an Arena. It is
+ * trivially destructible, so nodes that hold one can live in the arena too.
+ */
+template <typename T>
+class ArenaArray {
+private:
+    T* items;
+    uint32_t count;
+
+public:
+    ArenaArray() : items(nullptr), count(0) {}
+    ArenaArray(T* items, uint32_t count) : items(items), count(count) {}
+
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t index) const { return items[index]; }
+};
+
+/**
+ * Arena is a bump allocator. Allocations are carved from large blocks and
+ * never freed individually; destroying the arena releases every block at
+ * once. Only trivially destructible objects may be placed in it, since no
+ * destructor is ever run.
+ */
+class Arena {
+private:
+    struct Block {
+        Block* next;
+        size_t capacity;
+    };
+
+    Block* head;
+    char* cursor;
+    char* limit;
+    size_t nextBlockSize;
+    size_t bytesUsed_;
+    size_t bytesReserved_;
+
+    static constexpr size_t FIRST_BLOCK_SIZE = 4096;
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 20;
+
+    void grow(size_t minimum);
+
+public:
+    Arena() : head(nullptr), cursor(nullptr), limit(nullptr), nextBlockSize(FIRST_BLOCK_SIZE),
+              bytesUsed_(0), bytesReserved_(0) {}
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            grow(size + alignment);
+            aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        }
+        cursor = reinterpret_cast<char*>(aligned + size);
+        bytesUsed_ += size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copy `items[first..]` into the arena
+    template <typename T>
+    ArenaArray<T> copyArray(const std::vector<T>& items, size_t first = 0) {
+        static_assert(std::is_trivially_copyable_v<T>, "arena arrays are copied bytewise");
+        uint32_t count = static_cast<uint32_t>(items.size() - first);
+        if (count == 0) {
+            return ArenaArray<T>();
+        }
+        T* storage = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::copy(items.begin() + first, items.end(), storage);
+        return ArenaArray<T>(storage, count);
+    }
+
+    std::string_view copyString(std::string_view text);
+
+    size_t bytesUsed() const { return bytesUsed_; }
+    size_t bytesReserved() const { return bytesReserved_; }
+};
@@ -1,13 +1,48 @@
 #include "ast.h"
+#include <charconv>
+#include <ostream>
 #include <sstream>
 
+const char* binaryOperatorText(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::ADD: return "+";
+        case BinaryOperator::SUBTRACT: return "-";
+        case BinaryOperator::MULTIPLY: return "*";
+        case BinaryOperator::DIVIDE: return "/";
+    }
+    return "?";
+}
+
+void writeNumber(std::ostream& out, double value) {
+    // Fixed with six decimals is %f; the largest doubles run to 309
+    // integer digits
+    char buffer[330];
+    char* end = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6).ptr;
+    out.write(buffer, end - buffer);
+}
+
+std::string ASTNode::toString() const {
+    std::ostringstream out;
+    print(out);
+    return out.str();
+}
+
 // NumberLiteral
 void NumberLiteral::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string NumberLiteral::toString() const {
-    return std::to_string(value);
+void NumberLiteral::print(std::ostream& out) const {
+    writeNumber(out, value);
+}
+
+// IntegerLiteral
+void IntegerLiteral::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
+void IntegerLiteral::print(std::ostream& out) const {
+    out << value;
 }
 
 // StringLiteral
@@ -15,8 +50,8 @@ void StringLiteral::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string StringLiteral::toString() const {
-    return "\"" + value + "\"";
+void StringLiteral::print(std::ostream& out) const {
+    out << '"' << value << '"';
 }
 
 // Identifier
@@ -24,8 +59,8 @@ void Identifier::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string Identifier::toString() const {
-    return name;
+void Identifier::print(std::ostream& out) const {
+    out << symbols().name(name);
 }
 
 // BinaryExpression
@@ -33,8 +68,12 @@ void BinaryExpression::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string BinaryExpression::toString() const {
-    return "(" + left->toString() + " " + operator_ + " " + right->toString() + ")";
+void BinaryExpression::print(std::ostream& out) const {
+    out << '(';
+    left->print(out);
+    out << ' ' << binaryOperatorText(operator_) << ' ';
+    right->print(out);
+    out << ')';
 }
 
 // CallExpression
@@ -42,14 +81,14 @@ void CallExpression::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string CallExpression::toString() const {
-    std::string result = function->toString() + "(";
+void CallExpression::print(std::ostream& out) const {
+    function->print(out);
+    out << '(';
     for (size_t i = 0; i < arguments.size(); ++i) {
-        if (i > 0) result += ", ";
-        result += arguments[i]->toString();
+        if (i > 0) out << ", ";
+        arguments[i]->print(out);
     }
-    result += ")";
-    return result;
+    out << ')';
 }
 
 // ExpressionStatement
@@ -57,8 +96,9 @@ void ExpressionStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string ExpressionStatement::toString() const {
-    return expression->toString() + ";";
+void ExpressionStatement::print(std::ostream& out) const {
+    expression->print(out);
+    out << ';';
 }
 
 // LetStatement
@@ -66,8 +106,10 @@ void LetStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string LetStatement::toString() const {
-    return "let " + name + " = " + value->toString() + ";";
+void LetStatement::print(std::ostream& out) const {
+    out << "let " << symbols().name(name) << " = ";
+    value->print(out);
+    out << ';';
 }
 
 // BlockStatement
@@ -75,13 +117,14 @@ void BlockStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string BlockStatement::toString() const {
-    std::string result = "{\n";
+void BlockStatement::print(std::ostream& out) const {
+    out << "{\n";
     for (const auto& stmt : statements) {
-        result += "  " + stmt->toString() + "\n";
+        out << "  ";
+        stmt->print(out);
+        out << '\n';
     }
-    result += "}";
-    return result;
+    out << '}';
 }
 
 // FunctionDeclaration
@@ -89,14 +132,14 @@ void FunctionDeclaration::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string FunctionDeclaration::toString() const {
-    std::string result = "function " + name + "(";
+void FunctionDeclaration::print(std::ostream& out) const {
+    out << "function " << symbols().name(name) << '(';
     for (size_t i = 0; i < parameters.size(); ++i) {
-        if (i > 0) result += ", ";
-        result += parameters[i];
+        if (i > 0) out << ", ";
+        out << symbols().name(parameters[i]);
     }
-    result += ") " + body->toString();
-    return result;
+    out << ") ";
+    body->print(out);
 }
 
 // OnClickStatement
@@ -104,8 +147,39 @@ void OnClickStatement::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string OnClickStatement::toString() const {
-    return "onClick(\"" + elementId + "\") " + body->toString();
+void OnClickStatement::print(std::ostream& out) const {
+    out << "onClick(\"" << symbols().name(elementId) << "\") ";
+    body->print(out);
+}
+
+// ReturnStatement
+void ReturnStatement::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
+void ReturnStatement::print(std::ostream& out) const {
+    out << "return";
+    if (value) {
+        out << ' ';
+        value->print(out);
+    }
+    out << ';';
+}
+
+// IfStatement
+void IfStatement::accept(ASTVisitor& visitor) {
+    visitor.visit(*this);
+}
+
+void IfStatement::print(std::ostream& out) const {
+    out << "if (";
+    condition->print(out);
+    out << ") ";
+    consequence->print(out);
+    if (alternative) {
+        out << " else ";
+        alternative->print(out);
+    }
 }
 
 // Program
@@ -113,10 +187,9 @@ void Program::accept(ASTVisitor& visitor) {
     visitor.visit(*this);
 }
 
-std::string Program::toString() const {
-    std::string result;
+void Program::print(std::ostream& out) const {
     for (const auto& stmt : statements) {
-        result += stmt->toString() + "\n";
+        stmt->print(out);
+        out << '\n';
     }
-    return result;
 }
\ No newline at end of file
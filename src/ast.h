@@ -1,131 +1,221 @@
 #pragma once
-#include <memory>
-#include <vector>
+#include "arena.h"
+#include "flat_ast.h"
+#include "symbol.h"
+#include <cstdint>
+#include <iosfwd>
 #include <string>
+#include <string_view>
 
 // Forward declarations
 class ASTVisitor;
 
-// Base AST Node
+enum class BinaryOperator : uint8_t {
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE
+};
+
+const char* binaryOperatorText(BinaryOperator op);
+
+// The digits std::to_string(double) would give (printf's %f), written
+// without building a temporary string
+void writeNumber(std::ostream& out, double value);
+
+// Base AST Node. Nodes are allocated in their Program's arena and never
+// destroyed individually, so every node type must stay trivially
+// destructible: children are raw pointers, lists are ArenaArrays and text
+// is a string_view into the arena. Names are interned Symbols.
+//
+// Every node carries its NodeKind, so hot paths dispatch with one switch
+// and a static_cast instead of accept() plus a virtual visit(). accept()
+// remains for visitors where dispatch cost does not matter.
+//
+// print() streams a node's source-like text straight to `out`, so dumping
+// a tree is linear in its size however deep it nests.
+//
+// The span is set by whoever creates the node: the parser, or a pass
+// replacing a node, which hands the replacement the old node's span. It is
+// packed into the padding after the kind tag, so nodes whose first member
+// is 8-byte aligned stay the size they were without one. Lengths are kept
+// in 24 bits; a longer span keeps its start and reads back as
+// MAX_SPAN_LENGTH long.
 class ASTNode {
 public:
-    virtual ~ASTNode() = default;
+    const NodeKind kind;
+private:
+    uint32_t spanLength : 24;
+    uint32_t spanStart;
+    
+public:
+    static constexpr uint32_t MAX_SPAN_LENGTH = (1u << 24) - 1;
+    
+    explicit ASTNode(NodeKind k) : kind(k), spanLength(0), spanStart(0) {}
+    SourceSpan span() const { return SourceSpan{spanStart, spanLength}; }
+    void setSpan(SourceSpan span) {
+        spanStart = span.start;
+        spanLength = span.length < MAX_SPAN_LENGTH ? span.length : MAX_SPAN_LENGTH;
+    }
     virtual void accept(ASTVisitor& visitor) = 0;
-    virtual std::string toString() const = 0;
+    virtual void print(std::ostream& out) const = 0;
+    std::string toString() const;
 };
 
 // Expression nodes
 class Expression : public ASTNode {
 public:
-    virtual ~Expression() = default;
+    explicit Expression(NodeKind k) : ASTNode(k) {}
 };
 
 class NumberLiteral : public Expression {
 public:
     double value;
-    NumberLiteral(double val) : value(val) {}
+    NumberLiteral(double val) : Expression(NodeKind::NUMBER), value(val) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
+};
+
+class IntegerLiteral : public Expression {
+public:
+    int64_t value;
+    IntegerLiteral(int64_t val) : Expression(NodeKind::INTEGER), value(val) {}
+    void accept(ASTVisitor& visitor) override;
+    void print(std::ostream& out) const override;
 };
 
 class StringLiteral : public Expression {
 public:
-    std::string value;
-    StringLiteral(const std::string& val) : value(val) {}
+    std::string_view value;
+    StringLiteral(std::string_view val) : Expression(NodeKind::STRING), value(val) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class Identifier : public Expression {
 public:
-    std::string name;
-    Identifier(const std::string& n) : name(n) {}
+    Symbol name;
+    Identifier(Symbol n) : Expression(NodeKind::IDENTIFIER), name(n) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class BinaryExpression : public Expression {
 public:
-    std::unique_ptr<Expression> left;
-    std::string operator_;
-    std::unique_ptr<Expression> right;
+    Expression* left;
+    Expression* right;
+    BinaryOperator operator_;
     
-    BinaryExpression(std::unique_ptr<Expression> l, const std::string& op, std::unique_ptr<Expression> r)
-        : left(std::move(l)), operator_(op), right(std::move(r)) {}
+    BinaryExpression(Expression* l, BinaryOperator op, Expression* r)
+        : Expression(NodeKind::BINARY), left(l), right(r), operator_(op) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class CallExpression : public Expression {
 public:
-    std::unique_ptr<Expression> function;
-    std::vector<std::unique_ptr<Expression>> arguments;
+    Expression* function;
+    ArenaArray<Expression*> arguments;
     
-    CallExpression(std::unique_ptr<Expression> func) : function(std::move(func)) {}
+    CallExpression(Expression* func, ArenaArray<Expression*> args)
+        : Expression(NodeKind::CALL), function(func), arguments(args) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 // Statement nodes
 class Statement : public ASTNode {
 public:
-    virtual ~Statement() = default;
+    explicit Statement(NodeKind k) : ASTNode(k) {}
 };
 
 class ExpressionStatement : public Statement {
 public:
-    std::unique_ptr<Expression> expression;
-    ExpressionStatement(std::unique_ptr<Expression> expr) : expression(std::move(expr)) {}
+    Expression* expression;
+    ExpressionStatement(Expression* expr) : Statement(NodeKind::EXPRESSION_STATEMENT), expression(expr) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class LetStatement : public Statement {
 public:
-    std::string name;
-    std::unique_ptr<Expression> value;
+    Symbol name;
+    Expression* value;
     
-    LetStatement(const std::string& n, std::unique_ptr<Expression> val)
-        : name(n), value(std::move(val)) {}
+    LetStatement(Symbol n, Expression* val) : Statement(NodeKind::LET), name(n), value(val) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class BlockStatement : public Statement {
 public:
-    std::vector<std::unique_ptr<Statement>> statements;
+    ArenaArray<Statement*> statements;
+    
+    BlockStatement(ArenaArray<Statement*> stmts) : Statement(NodeKind::BLOCK), statements(stmts) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class FunctionDeclaration : public Statement {
 public:
-    std::string name;
-    std::vector<std::string> parameters;
-    std::unique_ptr<BlockStatement> body;
+    Symbol name;
+    ArenaArray<Symbol> parameters;
+    BlockStatement* body;
     
-    FunctionDeclaration(const std::string& n) : name(n) {}
+    FunctionDeclaration(Symbol n, ArenaArray<Symbol> params, BlockStatement* b)
+        : Statement(NodeKind::FUNCTION), name(n), parameters(params), body(b) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 class OnClickStatement : public Statement {
 public:
-    std::string elementId;
-    std::unique_ptr<BlockStatement> body;
+    Symbol elementId;
+    BlockStatement* body;
     
-    OnClickStatement(const std::string& id, std::unique_ptr<BlockStatement> b)
-        : elementId(id), body(std::move(b)) {}
+    OnClickStatement(Symbol id, BlockStatement* b) : Statement(NodeKind::ONCLICK), elementId(id), body(b) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
-// Program (root node)
-class Program : public ASTNode {
+// `return;` or `return value;`. In a function it ends the call; anywhere
+// else it ends the program or handler running.
+class ReturnStatement : public Statement {
 public:
-    std::vector<std::unique_ptr<Statement>> statements;
+    Expression* value;  // nullptr for a bare return
+    
+    ReturnStatement(Expression* val) : Statement(NodeKind::RETURN), value(val) {}
+    void accept(ASTVisitor& visitor) override;
+    void print(std::ostream& out) const override;
+};
+
+// The alternative is a block, another IfStatement for `else if`, or
+// nullptr without an else
+class IfStatement : public Statement {
+public:
+    Expression* condition;
+    BlockStatement* consequence;
+    Statement* alternative;
+    
+    IfStatement(Expression* cond, BlockStatement* then, Statement* otherwise)
+        : Statement(NodeKind::IF), condition(cond), consequence(then), alternative(otherwise) {}
+    void accept(ASTVisitor& visitor) override;
+    void print(std::ostream& out) const override;
+};
+
+// Program (root node). Owns the arena holding every other node, so
+// destroying the Program frees the whole tree at once. `flat` is the same
+// program linearized; its strings point into the arena.
+class Program final : public ASTNode {
+public:
+    Arena arena;
+    ArenaArray<Statement*> statements;
+    size_t nodeCount = 0;  // including the Program itself
+    FlatAST flat;
+    
+    Program() : ASTNode(NodeKind::PROGRAM) {}
     void accept(ASTVisitor& visitor) override;
-    std::string toString() const override;
+    void print(std::ostream& out) const override;
 };
 
 // Visitor pattern for AST traversal
@@ -133,6 +223,7 @@ class ASTVisitor {
 public:
     virtual ~ASTVisitor() = default;
     virtual void visit(NumberLiteral& node) = 0;
+    virtual void visit(IntegerLiteral& node) = 0;
     virtual void visit(StringLiteral& node) = 0;
     virtual void visit(Identifier& node) = 0;
     virtual void visit(BinaryExpression& node) = 0;
@@ -142,5 +233,7 @@ public:
     virtual void visit(BlockStatement& node) = 0;
     virtual void visit(FunctionDeclaration& node) = 0;
     virtual void visit(OnClickStatement& node) = 0;
+    virtual void visit(ReturnStatement& node) = 0;
+    virtual void visit(IfStatement& node) = 0;
     virtual void visit(Program& node) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,635 @@
+#include "bytecode.h"
+#include "ast.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+const char* opCodeName(OpCode op) {
+    switch (op) {
+        case OpCode::INTEGER: return "INTEGER";
+        case OpCode::NUMBER: return "NUMBER";
+        case OpCode::CONSTANT: return "CONSTANT";
+        case OpCode::ZERO: return "ZERO";
+        case OpCode::GET_LOCAL: return "GET_LOCAL";
+        case OpCode::GET_GLOBAL: return "GET_GLOBAL";
+        case OpCode::ADD: return "ADD";
+        case OpCode::SUBTRACT: return "SUBTRACT";
+        case OpCode::MULTIPLY: return "MULTIPLY";
+        case OpCode::DIVIDE: return "DIVIDE";
+        case OpCode::PRINT: return "PRINT";
+        case OpCode::POP: return "POP";
+        case OpCode::SET_LOCAL: return "SET_LOCAL";
+        case OpCode::SET_GLOBAL: return "SET_GLOBAL";
+        case OpCode::ON_CLICK: return "ON_CLICK";
+        case OpCode::JUMP: return "JUMP";
+        case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+        case OpCode::CALL: return "CALL";
+        case OpCode::TAIL_CALL: return "TAIL_CALL";
+        case OpCode::RETURN_VALUE: return "RETURN_VALUE";
+        case OpCode::RETURN: return "RETURN";
+        case OpCode::ADD_INT: return "ADD_INT";
+        case OpCode::ADD_NUMBER: return "ADD_NUMBER";
+        case OpCode::ADD_STRING: return "ADD_STRING";
+        case OpCode::ADD_CONCAT: return "ADD_CONCAT";
+        case OpCode::ADD_GENERIC: return "ADD_GENERIC";
+        case OpCode::SUBTRACT_INT: return "SUBTRACT_INT";
+        case OpCode::SUBTRACT_NUMBER: return "SUBTRACT_NUMBER";
+        case OpCode::SUBTRACT_GENERIC: return "SUBTRACT_GENERIC";
+        case OpCode::MULTIPLY_INT: return "MULTIPLY_INT";
+        case OpCode::MULTIPLY_NUMBER: return "MULTIPLY_NUMBER";
+        case OpCode::MULTIPLY_GENERIC: return "MULTIPLY_GENERIC";
+    }
+    return "?";
+}
+
+uint32_t instructionLength(OpCode op) {
+    switch (op) {
+        case OpCode::INTEGER:
+        case OpCode::NUMBER:
+        case OpCode::ON_CLICK:
+        case OpCode::CALL:
+        case OpCode::TAIL_CALL:
+            return 9;
+        case OpCode::CONSTANT:
+        case OpCode::GET_LOCAL:
+        case OpCode::GET_GLOBAL:
+        case OpCode::SET_LOCAL:
+        case OpCode::SET_GLOBAL:
+        case OpCode::JUMP:
+        case OpCode::JUMP_IF_FALSE:
+            return 5;
+        default:
+            return 1;
+    }
+}
+
+uint32_t GlobalScope::slot(Symbol name) {
+    if (name >= slots.size()) {
+        slots.resize(name + 1, NO_SLOT);
+        bound.resize(name + 1, false);
+    }
+    if (slots[name] == NO_SLOT) {
+        slots[name] = count++;
+    }
+    return slots[name];
+}
+
+uint32_t GlobalScope::function(Symbol name) {
+    if (name >= functionSlots.size()) {
+        functionSlots.resize(name + 1, NO_SLOT);
+    }
+    if (functionSlots[name] == NO_SLOT) {
+        functionSlots[name] = static_cast<uint32_t>(functionNames.size());
+        functionNames.push_back(name);
+    }
+    return functionSlots[name];
+}
+
+SourceSpan Chunk::spanAt(uint32_t offset) const {
+    auto it = std::lower_bound(spans.begin(), spans.end(), offset,
+                               [](const std::pair<uint32_t, SourceSpan>& entry, uint32_t value) {
+                                   return entry.first < value;
+                               });
+    return it != spans.end() && it->first == offset ? it->second : SourceSpan{0, 0};
+}
+
+static void writeValue(std::ostream& out, const Value& value) {
+    if (value.isDouble()) {
+        writeNumber(out, value.asDouble());
+    } else if (value.isInteger()) {
+        out << value.asInteger();
+    } else if (value.isString()) {
+        out << '"' << value.asString().view() << '"';
+    } else {
+        out << (value.asBoolean() ? "true" : "false");
+    }
+}
+
+void Chunk::disassemble(std::ostream& out) const {
+    out << code.size() << " bytes, " << constants.size() << " constants, stack depth " << maxStack << ", "
+        << maxLocals << " frame slots\n";
+    for (const CompiledFunction& function : functions) {
+        out << "function " << function.slot << " at " << std::setw(6) << std::setfill('0') << function.entry
+            << std::setfill(' ') << ": " << function.arity << " parameters, " << function.frameSize
+            << " frame slots\n";
+    }
+    uint32_t offset = 0;
+    while (offset < code.size()) {
+        OpCode op = static_cast<OpCode>(code[offset]);
+        out << std::setw(6) << std::setfill('0') << offset << std::setfill(' ') << "  " << opCodeName(op);
+        uint32_t operand = 0;
+        if (instructionLength(op) > 1) {
+            operand = readOperand(offset + 1);
+            out << std::string(15 - std::strlen(opCodeName(op)), ' ');
+        }
+        switch (op) {
+            case OpCode::INTEGER:
+                out << readOperand<int64_t>(offset + 1);
+                break;
+            case OpCode::NUMBER:
+                writeNumber(out, readOperand<double>(offset + 1));
+                break;
+            case OpCode::CONSTANT:
+                out << operand << "  ";
+                writeValue(out, constants[operand]);
+                break;
+            case OpCode::GET_LOCAL:
+            case OpCode::GET_GLOBAL:
+            case OpCode::SET_LOCAL:
+            case OpCode::SET_GLOBAL:
+                out << operand;
+                break;
+            case OpCode::ON_CLICK:
+                out << '"' << symbols().name(operand) << "\"  at " << std::setw(6) << std::setfill('0')
+                    << readOperand(offset + 5) << std::setfill(' ');
+                break;
+            case OpCode::JUMP:
+            case OpCode::JUMP_IF_FALSE:
+                out << std::setw(6) << std::setfill('0') << operand << std::setfill(' ');
+                break;
+            case OpCode::CALL:
+            case OpCode::TAIL_CALL:
+                out << "function " << operand << ", " << readOperand(offset + 5) << " arguments";
+                break;
+            default:
+                break;
+        }
+        out << '\n';
+        offset += instructionLength(op);
+    }
+}
+
+/**
+ * Emits code for a flat program in one walk, as the flat walker it
+ * replaces evaluated it: expressions in post-order onto the stack,
+ * statements in order. Like FlatBuilder, the walk recurses and past
+ * RECURSION_LIMIT keeps its own stack, so expressions of any depth compile.
+ * Numbers are emitted inline and strings refer to their index in the
+ * FlatAST, so compiling never hashes a literal.
+ *
+ * Names are resolved in the same walk. `locals` holds the frame slot of
+ * each name's innermost binding, indexed by Symbol, and `shadowed` the
+ * bindings a block's lets hid, to put back when the block ends. Lookup is
+ * one index whatever the nesting.
+ *
+ * Calls name their function by its slot in the GlobalScope. Every
+ * function the program declares gets its slot before any code is
+ * compiled, and its body is compiled, like a handler's, after the
+ * program's RETURN.
+ */
+class BytecodeCompiler {
+private:
+    const FlatAST& ast;
+    Chunk chunk;
+    GlobalScope& globals;
+    uint32_t depth;  // values on the stack at this point of the code
+    std::vector<uint32_t> locals;  // by Symbol; NO_SLOT when not bound in a block
+    std::vector<std::pair<Symbol, uint32_t>> shadowed;  // (name, slot it had)
+    uint32_t blocks;     // blocks open around this point; 0 at top level
+    uint32_t blockBase;  // first slot of the innermost block
+    uint32_t nextSlot;
+    uint32_t frameSlots;  // slots the entry point being compiled needs so far
+    bool inFunction;      // whether `return` ends a call, or the whole run
+    std::vector<std::pair<uint32_t, NodeIndex>> handlers;  // (ON_CLICK offset operand, body)
+    std::vector<NodeIndex> functions;  // every FUNCTION node, in declaration order
+
+    // An expression whose operands are being compiled, past RECURSION_LIMIT
+    struct Visit {
+        NodeIndex index;
+        uint32_t next;   // the operand to compile next
+        uint32_t count;  // how many operands it has
+    };
+    std::vector<Visit> operands;
+
+    uint32_t here() const { return static_cast<uint32_t>(chunk.code.size()); }
+
+    void emit(OpCode op) { chunk.code.push_back(static_cast<uint8_t>(op)); }
+
+    template <typename T = uint32_t>
+    void emitOperand(T value) {
+        size_t at = chunk.code.size();
+        chunk.code.resize(at + sizeof(value));
+        std::memcpy(&chunk.code[at], &value, sizeof(value));
+    }
+
+    void push() {
+        depth++;
+        chunk.maxStack = std::max(chunk.maxStack, depth);
+    }
+
+    // Record `index`'s span for the instruction about to be emitted
+    void mark(NodeIndex index) { chunk.spans.emplace_back(here(), ast.spans[index]); }
+
+    template <typename T>
+    void literal(OpCode op, T value) {
+        emit(op);
+        emitOperand<T>(value);
+        push();
+    }
+
+    // The slot for a let of `name` in the innermost block: its own if the
+    // block already binds it, else a new one that shadows any outer binding
+    uint32_t declareLocal(Symbol name) {
+        uint32_t slot = locals[name];
+        if (slot != NO_SLOT && slot >= blockBase) {
+            return slot;
+        }
+        shadowed.emplace_back(name, slot);
+        locals[name] = nextSlot;
+        frameSlots = std::max(frameSlots, nextSlot + 1);
+        chunk.maxLocals = std::max(chunk.maxLocals, frameSlots);
+        return nextSlot++;
+    }
+
+    // Point the jump whose operand is at `operandAt` to `target`
+    void patch(uint32_t operandAt, uint32_t target) {
+        std::memcpy(&chunk.code[operandAt], &target, sizeof(target));
+    }
+
+    // The name a call's callee gives, or NO_SYMBOL when it is not a name
+    Symbol calleeName(NodeIndex call) const {
+        NodeIndex callee = ast.node(call).a;
+        return callee != NO_NODE && ast.kind(callee) == NodeKind::IDENTIFIER ? ast.node(callee).a : NO_SYMBOL;
+    }
+
+    // Whether `index` calls a function, not print
+    bool isFunctionCall(NodeIndex index) const {
+        if (index == NO_NODE || ast.kind(index) != NodeKind::CALL) {
+            return false;
+        }
+        Symbol name = calleeName(index);
+        return name != NO_SYMBOL && name != SYMBOL_PRINT;
+    }
+
+    // CALL or TAIL_CALL, the arguments already on the stack, leaving the
+    // result
+    void invoke(NodeIndex index, OpCode op) {
+        const FlatNode& node = ast.node(index);
+        mark(index);
+        emit(op);
+        emitOperand(globals.function(ast.node(node.a).a));
+        emitOperand(node.c);
+        depth -= node.c;
+        push();
+    }
+
+    // The arguments in order, then CALL or TAIL_CALL, leaving the result
+    void call(NodeIndex index, OpCode op) {
+        const FlatNode& node = ast.node(index);
+        for (uint32_t i = 0; i < node.c; i++) {
+            expression(ast.lists[node.b + i]);
+        }
+        invoke(index, op);
+    }
+
+    void variable(NodeIndex index, Symbol name) {
+        uint32_t slot = locals[name];
+        if (slot != NO_SLOT) {
+            emit(OpCode::GET_LOCAL);
+            emitOperand(slot);
+        } else {
+            if (!globals.isBound(name)) {
+                chunk.undefined.emplace_back(ast.spans[index], name);
+            }
+            emit(OpCode::GET_GLOBAL);
+            emitOperand(globals.slot(name));
+        }
+        push();
+    }
+
+    // How many values `index` evaluates before its own instruction: both
+    // sides of arithmetic, a function call's arguments, print's first
+    uint32_t operandCount(NodeIndex index) const {
+        if (index == NO_NODE) {
+            return 0;
+        }
+        const FlatNode& node = ast.node(index);
+        switch (ast.kind(index)) {
+            case NodeKind::BINARY:
+                return 2;
+            case NodeKind::CALL:
+                if (isFunctionCall(index)) {
+                    return node.c;
+                }
+                // print evaluates its first argument only
+                return calleeName(index) == SYMBOL_PRINT && node.c > 0 ? 1 : 0;
+            default:
+                return 0;
+        }
+    }
+
+    NodeIndex operandAt(NodeIndex index, uint32_t i) const {
+        const FlatNode& node = ast.node(index);
+        if (ast.kind(index) == NodeKind::BINARY) {
+            return i == 0 ? node.a : node.b;
+        }
+        return ast.lists[node.b + i];
+    }
+
+    // The arithmetic instruction of a BINARY, its operands on the stack
+    void arithmetic(NodeIndex index) {
+        static_assert(static_cast<uint8_t>(OpCode::DIVIDE) - static_cast<uint8_t>(OpCode::ADD) ==
+                          static_cast<uint8_t>(BinaryOperator::DIVIDE),
+                      "arithmetic opcodes follow BinaryOperator order");
+        mark(index);
+        emit(static_cast<OpCode>(static_cast<uint8_t>(OpCode::ADD) + ast.node(index).c));
+        depth--;
+    }
+
+    // What expression emits for `index` after its operands, for the walk
+    // past RECURSION_LIMIT, which has put them on the stack already
+    void finish(NodeIndex index) {
+        if (index == NO_NODE) {
+            emit(OpCode::ZERO);
+            push();
+            return;
+        }
+        const FlatNode& node = ast.node(index);
+        switch (ast.kind(index)) {
+            case NodeKind::NUMBER:
+                literal(OpCode::NUMBER, ast.number(index));
+                break;
+            case NodeKind::INTEGER:
+                literal(OpCode::INTEGER, ast.integer(index));
+                break;
+            case NodeKind::STRING:
+                literal(OpCode::CONSTANT, node.a);
+                break;
+            case NodeKind::IDENTIFIER:
+                variable(index, node.a);
+                break;
+            case NodeKind::BINARY:
+                arithmetic(index);
+                break;
+            case NodeKind::CALL:
+                if (isFunctionCall(index)) {
+                    invoke(index, OpCode::CALL);
+                } else if (calleeName(index) == SYMBOL_PRINT && node.c > 0) {
+                    emit(OpCode::PRINT);
+                } else {
+                    emit(OpCode::ZERO);
+                    push();
+                }
+                break;
+            default:
+                // Statements never appear as operands
+                emit(OpCode::ZERO);
+                push();
+                break;
+        }
+    }
+
+    // Past this depth the walk stops recursing and keeps its own stack
+    static constexpr size_t RECURSION_LIMIT = 4096;
+
+    void expression(NodeIndex index, size_t level = 0) {
+        if (index == NO_NODE) {
+            emit(OpCode::ZERO);
+            push();
+            return;
+        }
+        if (level == RECURSION_LIMIT) {
+            expressionIteratively(index);
+            return;
+        }
+        const FlatNode& node = ast.node(index);
+        switch (ast.kind(index)) {
+            case NodeKind::NUMBER:
+                literal(OpCode::NUMBER, ast.number(index));
+                break;
+            case NodeKind::INTEGER:
+                literal(OpCode::INTEGER, ast.integer(index));
+                break;
+            case NodeKind::STRING:
+                literal(OpCode::CONSTANT, node.a);
+                break;
+            case NodeKind::IDENTIFIER:
+                variable(index, node.a);
+                break;
+            case NodeKind::BINARY:
+                expression(node.a, level + 1);
+                expression(node.b, level + 1);
+                arithmetic(index);
+                break;
+            case NodeKind::CALL:
+                if (isFunctionCall(index)) {
+                    for (uint32_t i = 0; i < node.c; i++) {
+                        expression(ast.lists[node.b + i], level + 1);
+                    }
+                    invoke(index, OpCode::CALL);
+                } else if (calleeName(index) == SYMBOL_PRINT && node.c > 0) {
+                    // print evaluates its first argument only
+                    expression(ast.lists[node.b], level + 1);
+                    emit(OpCode::PRINT);
+                } else {
+                    emit(OpCode::ZERO);
+                    push();
+                }
+                break;
+            default:
+                // Statements never appear as operands
+                emit(OpCode::ZERO);
+                push();
+                break;
+        }
+    }
+
+    void expressionIteratively(NodeIndex root) {
+        operands.push_back(Visit{root, 0, operandCount(root)});
+        while (!operands.empty()) {
+            Visit& top = operands.back();
+            if (top.next == top.count) {
+                NodeIndex done = top.index;
+                operands.pop_back();
+                finish(done);
+                continue;
+            }
+            NodeIndex operand = operandAt(top.index, top.next++);
+            operands.push_back(Visit{operand, 0, operandCount(operand)});
+        }
+    }
+
+    // A function body, as its own entry point. CALL leaves the arguments
+    // in the first slots of the frame, so the parameters are bound there,
+    // a later one of a repeated name winning; the body's block follows.
+    void function(NodeIndex index) {
+        const FlatNode& node = ast.node(index);
+        uint32_t entry = here();
+        blocks++;
+        for (uint32_t p = 0; p < node.c; p++) {
+            Symbol parameter = ast.lists[node.b + 1 + p];
+            shadowed.emplace_back(parameter, locals[parameter]);
+            locals[parameter] = p;
+        }
+        nextSlot = frameSlots = node.c;
+        chunk.maxLocals = std::max(chunk.maxLocals, frameSlots);
+        inFunction = true;
+        statement(ast.lists[node.b]);
+        // Falling off the end returns 0.0
+        emit(OpCode::ZERO);
+        push();
+        emit(OpCode::RETURN_VALUE);
+        depth--;
+        inFunction = false;
+        while (!shadowed.empty()) {
+            locals[shadowed.back().first] = shadowed.back().second;
+            shadowed.pop_back();
+        }
+        nextSlot = 0;
+        blocks--;
+        chunk.functions.push_back(CompiledFunction{globals.function(node.a), entry, node.c, frameSlots});
+    }
+
+    void statements(const FlatNode& node) {
+        for (uint32_t i = 0; i < node.c; i++) {
+            statement(ast.lists[node.b + i]);
+        }
+    }
+
+    void statement(NodeIndex index) {
+        if (index == NO_NODE) {
+            return;
+        }
+        const FlatNode& node = ast.node(index);
+        switch (ast.kind(index)) {
+            case NodeKind::EXPRESSION_STATEMENT:
+                expression(node.a);
+                emit(OpCode::POP);
+                depth--;
+                break;
+            case NodeKind::LET:
+                // The value first: in `let x = x + 1` it reads the outer x
+                expression(node.b);
+                if (blocks == 0) {
+                    emit(OpCode::SET_GLOBAL);
+                    emitOperand(globals.bind(node.a));
+                } else {
+                    emit(OpCode::SET_LOCAL);
+                    emitOperand(declareLocal(node.a));
+                }
+                depth--;
+                break;
+            case NodeKind::BLOCK: {
+                // Nothing to run on entry or exit: the block's slots follow
+                // the outer ones and are free for the next block once it ends
+                uint32_t outerBase = blockBase;
+                size_t outerShadowed = shadowed.size();
+                blockBase = nextSlot;
+                blocks++;
+                statements(node);
+                blocks--;
+                while (shadowed.size() > outerShadowed) {
+                    locals[shadowed.back().first] = shadowed.back().second;
+                    shadowed.pop_back();
+                }
+                nextSlot = blockBase;
+                blockBase = outerBase;
+                break;
+            }
+            case NodeKind::FUNCTION:
+                // Hoisted: declared before the program runs
+                break;
+            case NodeKind::ONCLICK:
+                emit(OpCode::ON_CLICK);
+                emitOperand(node.a);
+                handlers.emplace_back(here(), node.b);
+                emitOperand(0);  // its entry, once the body is compiled
+                break;
+            case NodeKind::RETURN:
+                if (!inFunction) {
+                    // Ends the program or handler; the value is only kept
+                    if (node.a != NO_NODE) {
+                        expression(node.a);
+                        emit(OpCode::POP);
+                        depth--;
+                    }
+                    emit(OpCode::RETURN);
+                } else if (isFunctionCall(node.a)) {
+                    // TAIL_CALL only falls through when the function is
+                    // undefined, with 0.0 to return
+                    call(node.a, OpCode::TAIL_CALL);
+                    emit(OpCode::RETURN_VALUE);
+                    depth--;
+                } else {
+                    expression(node.a);
+                    emit(OpCode::RETURN_VALUE);
+                    depth--;
+                }
+                break;
+            case NodeKind::IF: {
+                expression(node.a);
+                emit(OpCode::JUMP_IF_FALSE);
+                depth--;
+                uint32_t skip = here();
+                emitOperand(0);
+                statement(node.b);
+                if (node.c != NO_NODE) {
+                    emit(OpCode::JUMP);
+                    uint32_t end = here();
+                    emitOperand(0);
+                    patch(skip, here());
+                    statement(node.c);
+                    patch(end, here());
+                } else {
+                    patch(skip, here());
+                }
+                break;
+            }
+            case NodeKind::PROGRAM:
+                statements(node);
+                break;
+            default:
+                // A bare expression, which the parser never produces
+                expression(index);
+                emit(OpCode::POP);
+                depth--;
+                break;
+        }
+    }
+
+public:
+    BytecodeCompiler(const FlatAST& ast, GlobalScope& globals)
+        : ast(ast), globals(globals), depth(0), locals(symbols().size(), NO_SLOT), blocks(0), blockBase(0),
+          nextSlot(0), frameSlots(0), inFunction(false) {}
+
+    Chunk compile() {
+        // Roughly six bytes of code per node
+        chunk.code.reserve(ast.size() * 6);
+        chunk.spans.reserve(ast.size() / 2);
+        chunk.constants.reserve(ast.strings.size());
+        for (std::string_view text : ast.strings) {
+            chunk.constants.push_back(Value::literal(text));
+        }
+        // Post-order puts nested declarations before the ones around them
+        for (NodeIndex i = 0; i < ast.size(); i++) {
+            if (ast.kind(i) == NodeKind::FUNCTION) {
+                globals.function(ast.node(i).a);
+                functions.push_back(i);
+            }
+        }
+        statement(ast.root);
+        emit(OpCode::RETURN);
+        // Handlers and functions run after the program has started, in
+        // the top-level scope: their bodies are compiled once every
+        // top-level let is bound, with no block open. Handlers nested in
+        // them are appended as they are compiled.
+        for (size_t h = 0, f = 0; h < handlers.size() || f < functions.size();) {
+            if (h < handlers.size()) {
+                auto [operandAt, body] = handlers[h++];
+                patch(operandAt, here());
+                frameSlots = 0;
+                statement(body);
+                emit(OpCode::RETURN);
+            } else {
+                function(functions[f++]);
+            }
+        }
+        return std::move(chunk);
+    }
+};
+
+Chunk compileBytecode(const FlatAST& ast, GlobalScope& globals) {
+    return BytecodeCompiler(ast, globals).compile();
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include "flat_ast.h"
+#include "source.h"
+#include "symbol.h"
+#include "value.h"
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <vector>
+
+/**
+ * Instructions of the stack machine the Interpreter runs. Each is one
+ * opcode byte followed by its operands, native-endian: a uint32 each,
+ * except the 64-bit literal of INTEGER and NUMBER. Expressions leave
+ * exactly one value on the stack; statements leave it as they found it.
+ * Jump targets and entry points are offsets into the chunk's code.
+ *
+ * A call's arguments are pushed in order and become the first slots of
+ * the callee's frame where they lie, so calling copies no value.
+ *
+ * The compiler emits ADD, SUBTRACT and MULTIPLY unspecialized. Each
+ * rewrites its own opcode the first time it runs, to the form for the
+ * operand types it saw. A specialized form checks those types before its
+ * fast path. When they no longer hold, it widens in place: INT to NUMBER,
+ * STRING to CONCAT, and anything else to GENERIC, which stays.
+ */
+enum class OpCode : uint8_t {
+    INTEGER,        // int64: push it
+    NUMBER,         // double: push it
+    CONSTANT,       // index: push constants[index]
+    ZERO,           // push 0.0, the value of print() and of failed calls
+    GET_LOCAL,      // slot: push the frame slot's value
+    GET_GLOBAL,     // slot: push the global's value
+    ADD,            // pop right, then left; push left op right
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,         // never specialized: it checks for zero whatever the types
+    PRINT,          // print the top value and replace it with 0.0
+    POP,            // pop, keeping the value as the interpreter's last value
+    SET_LOCAL,      // slot: pop into the frame slot
+    SET_GLOBAL,     // slot: pop into the global
+    ON_CLICK,       // symbol, offset: register the code at `offset` as the handler
+    JUMP,           // offset: continue there
+    JUMP_IF_FALSE,  // offset: pop, and continue there if the value is false
+    CALL,           // function, count: call it on the top `count` values
+    TAIL_CALL,      // function, count: as CALL, but in the caller's own frame
+    RETURN_VALUE,   // pop the result, end the call and push it for the caller
+    RETURN,         // end of the program or of a handler
+
+    // Specialized arithmetic, only ever written by the VM
+    ADD_INT,           // two inline integers
+    ADD_NUMBER,        // two numbers, at least one a double
+    ADD_STRING,        // two strings
+    ADD_CONCAT,        // a string and anything else
+    ADD_GENERIC,       // whatever the types
+    SUBTRACT_INT,
+    SUBTRACT_NUMBER,
+    SUBTRACT_GENERIC,
+    MULTIPLY_INT,
+    MULTIPLY_NUMBER,
+    MULTIPLY_GENERIC
+};
+
+const char* opCodeName(OpCode op);
+// Bytes an instruction takes, opcode included
+uint32_t instructionLength(OpCode op);
+
+constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+/**
+ * Slots of the top-level variables and of the functions. One interpreter compiles every chunk
+ * against the same scope, so a chunk sees the variables of those compiled
+ * before it (earlier interactive lines) as well as its own.
+ *
+ * A name read before any let binds it is reported, but still given a slot,
+ * holding 0.0 until a let stores to it. A handler compiled before that let
+ * (typed on an earlier interactive line) then reads what it stores, as when
+ * names were looked up each time a handler ran.
+ */
+struct GlobalScope {
+    std::vector<uint32_t> slots;  // by Symbol; NO_SLOT until the name is first seen
+    std::vector<bool> bound;      // by Symbol; whether a let has bound it
+    uint32_t count = 0;
+    // Functions have names of their own: a function and a variable may
+    // share one. A call names its function by slot, so a call compiled
+    // before the declaration it calls (or before a redeclaration) calls
+    // whatever the slot holds when it runs.
+    std::vector<uint32_t> functionSlots;  // by Symbol; NO_SLOT until the name is first called or declared
+    std::vector<Symbol> functionNames;    // by function slot
+
+    // The name's slot, given a new one the first time it is seen
+    uint32_t slot(Symbol name);
+    uint32_t bind(Symbol name) {
+        uint32_t index = slot(name);
+        bound[name] = true;
+        return index;
+    }
+    bool isBound(Symbol name) const { return name < bound.size() && bound[name]; }
+    // The function's slot, given a new one the first time it is seen
+    uint32_t function(Symbol name);
+};
+
+// A function declared in a Chunk. Its code starts at `entry` and runs in
+// a frame of `frameSize` slots, the first `arity` holding its arguments.
+struct CompiledFunction {
+    uint32_t slot;
+    uint32_t entry;
+    uint32_t arity;
+    uint32_t frameSize;
+};
+
+/**
+ * A compiled program: its code, its string literals and, for each
+ * instruction that can report a runtime error, the span of the node it
+ * came from. Handler and function bodies follow the program's own RETURN,
+ * so one Chunk holds every entry point its program registers or declares.
+ *
+ * Every name is resolved when the chunk is compiled: a variable is a
+ * global or a slot in the frame of the entry point running, never a
+ * lookup by name. Block scopes share their entry point's frame, each
+ * one's slots laid out after those of the blocks around it. A function
+ * sees its parameters, its own lets and the globals, never the locals of
+ * whatever calls it.
+ *
+ * Functions are hoisted: every one a program declares, however deeply,
+ * can be called from anywhere in it, and from any chunk compiled later.
+ */
+struct Chunk {
+    std::vector<uint8_t> code;
+    std::vector<Value> constants;  // the FlatAST's strings, by the same index
+    // (code offset, span), ascending by offset; read only on errors
+    std::vector<std::pair<uint32_t, SourceSpan>> spans;
+    // Names read where no let before them binds them. Each reads as 0.0,
+    // or as a global bound later on.
+    std::vector<std::pair<SourceSpan, Symbol>> undefined;
+    // In the order declared; a later one of the same name replaces an earlier
+    std::vector<CompiledFunction> functions;
+    uint32_t maxStack = 0;   // deepest the value stack gets in any frame
+    uint32_t maxLocals = 0;  // frame slots the largest entry point needs
+
+    template <typename T = uint32_t>
+    T readOperand(uint32_t offset) const {
+        T value;
+        std::memcpy(&value, &code[offset], sizeof(value));
+        return value;
+    }
+    // The span recorded for the instruction at `offset`
+    SourceSpan spanAt(uint32_t offset) const;
+
+    // One instruction per line: offset, name, operands and what they refer to
+    void disassemble(std::ostream& out) const;
+};
+
+// Compiles a flat program, binding its top-level lets in `globals`.
+// Children missing after parse errors compile to ZERO, so a Chunk can
+// always be run.
+Chunk compileBytecode(const FlatAST& ast, GlobalScope& globals);
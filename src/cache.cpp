@@ -0,0 +1,331 @@
+#include "cache.h"
+#include "source.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+static constexpr char CACHE_MAGIC[4] = {'K', 'S', 'C', '\0'};
+static constexpr uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t byteOrder;  // CACHE_BYTE_ORDER as the writer stored it
+    uint32_t formatVersion;
+    uint32_t nodeSize;  // sizeof(FlatNode)
+    uint64_t sourceHash;
+    uint64_t configHash;
+    uint32_t nodeCount;
+    uint32_t listCount;
+    uint32_t stringCount;
+    uint32_t stringBytes;
+    uint32_t symbolCount;
+    uint32_t symbolBytes;
+    uint32_t root;
+    uint32_t reserved;
+};
+
+// FNV-1a, 64-bit
+static uint64_t hashBytes(std::string_view bytes, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static size_t padded(size_t size) {
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+CacheKey makeCacheKey(std::string_view source, const std::string& configuration) {
+    std::string config = std::string("karou ") + KAROU_VERSION + "/" + std::to_string(CACHE_FORMAT_VERSION) + "/" +
+                         configuration;
+    return CacheKey{hashBytes(source), hashBytes(config)};
+}
+
+std::string cachePath(const std::string& sourcePath, const std::string& directory, const CacheKey& key) {
+    if (directory.empty()) {
+        bool isKs = sourcePath.size() > 3 && sourcePath.compare(sourcePath.size() - 3, 3, ".ks") == 0;
+        return sourcePath + (isKs ? "c" : ".ksc");
+    }
+    char name[40];
+    std::snprintf(name, sizeof(name), "%016llx-%08x.ksc", static_cast<unsigned long long>(key.sourceHash),
+                  static_cast<unsigned>(key.configHash));
+    return directory + "/" + name;
+}
+
+// Offsets table plus bytes, as one section
+static void appendStrings(std::string& out, const std::vector<std::string_view>& strings) {
+    std::vector<uint32_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    uint32_t offset = 0;
+    for (std::string_view text : strings) {
+        offsets.push_back(offset);
+        offset += static_cast<uint32_t>(text.size());
+    }
+    offsets.push_back(offset);
+    out.append(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    for (std::string_view text : strings) {
+        out.append(text);
+    }
+    out.resize(padded(out.size()));
+}
+
+bool storeCachedProgram(const std::string& path, const CacheKey& key, const FlatAST& flat) {
+    const SymbolTable& table = symbols();
+    std::vector<std::string_view> names;
+    names.reserve(table.size());
+    size_t nameBytes = 0;
+    for (Symbol symbol = 0; symbol < table.size(); symbol++) {
+        names.push_back(table.name(symbol));
+        nameBytes += names.back().size();
+    }
+    size_t stringBytes = 0;
+    for (std::string_view text : flat.strings) {
+        stringBytes += text.size();
+    }
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.byteOrder = CACHE_BYTE_ORDER;
+    header.formatVersion = CACHE_FORMAT_VERSION;
+    header.nodeSize = sizeof(FlatNode);
+    header.sourceHash = key.sourceHash;
+    header.configHash = key.configHash;
+    header.nodeCount = static_cast<uint32_t>(flat.size());
+    header.listCount = static_cast<uint32_t>(flat.lists.size());
+    header.stringCount = static_cast<uint32_t>(flat.strings.size());
+    header.stringBytes = static_cast<uint32_t>(stringBytes);
+    header.symbolCount = static_cast<uint32_t>(names.size());
+    header.symbolBytes = static_cast<uint32_t>(nameBytes);
+    header.root = flat.root;
+
+    std::string out;
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(flat.kinds.data()), flat.kinds.size());
+    out.resize(padded(out.size()));
+    out.append(reinterpret_cast<const char*>(flat.nodes.data()), flat.nodes.size() * sizeof(FlatNode));
+    out.append(reinterpret_cast<const char*>(flat.spans.data()), flat.spans.size() * sizeof(SourceSpan));
+    out.append(reinterpret_cast<const char*>(flat.lists.data()), flat.lists.size() * sizeof(uint32_t));
+    appendStrings(out, flat.strings);
+    appendStrings(out, names);
+
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < out.size()) {
+        ssize_t n = write(fd, out.data() + written, out.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    bool ok = written == out.size() && close(fd) == 0;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        int savedErrno = errno;
+        if (written != out.size()) close(fd);
+        unlink(temp.c_str());
+        errno = savedErrno;
+        return false;
+    }
+    return true;
+}
+
+// Reads sections of a mapped entry in order, refusing to run past its end
+class CacheReader {
+private:
+    std::string_view bytes;
+    size_t offset;
+
+public:
+    explicit CacheReader(std::string_view bytes) : bytes(bytes), offset(0) {}
+
+    const char* take(size_t size) {
+        if (size > bytes.size() - offset) {
+            return nullptr;
+        }
+        const char* data = bytes.data() + offset;
+        offset += size;
+        return data;
+    }
+
+    template <typename T>
+    bool read(std::vector<T>& items, size_t count) {
+        const char* data = take(count * sizeof(T));
+        if (!data) {
+            return false;
+        }
+        items.resize(count);
+        std::memcpy(items.data(), data, count * sizeof(T));
+        return true;
+    }
+
+    // The offsets-then-bytes section written by appendStrings
+    bool readStrings(size_t count, size_t totalBytes, std::vector<uint32_t>& offsets, std::string_view& text) {
+        if (!read(offsets, count + 1) || offsets[0] != 0 || offsets[count] != totalBytes) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (offsets[i] > offsets[i + 1]) {
+                return false;
+            }
+        }
+        const char* data = take(totalBytes);
+        if (!data) {
+            return false;
+        }
+        text = std::string_view(data, totalBytes);
+        return take(padded(offset) - offset) != nullptr;
+    }
+
+    void align() { offset = std::min(padded(offset), bytes.size()); }
+    bool atEnd() const { return offset == bytes.size(); }
+};
+
+// Checks every operand of every node before the interpreter trusts it, and
+// maps the entry's symbols onto this process's. Nodes are in post-order,
+// so each child index must be below its parent's, which also rules out
+// cycles.
+static bool validate(FlatAST& flat, uint32_t stringCount, const std::vector<Symbol>& remap, bool identity) {
+    auto child = [](uint32_t index, NodeIndex parent) { return index < parent; };
+    auto optional = [&](uint32_t index, NodeIndex parent) { return index == NO_NODE || child(index, parent); };
+    auto symbol = [&](uint32_t& operand) {
+        if (operand >= remap.size()) return false;
+        if (!identity) operand = remap[operand];
+        return true;
+    };
+    auto list = [&](uint32_t start, uint32_t count, NodeIndex parent) {
+        if (static_cast<uint64_t>(start) + count > flat.lists.size()) return false;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!child(flat.lists[start + i], parent)) return false;
+        }
+        return true;
+    };
+
+    for (NodeIndex i = 0; i < flat.size(); i++) {
+        FlatNode& n = flat.nodes[i];
+        bool ok = false;
+        switch (flat.kinds[i]) {
+            case NodeKind::NUMBER:
+            case NodeKind::INTEGER:
+                ok = true;
+                break;
+            case NodeKind::STRING:
+                ok = n.a < stringCount;
+                break;
+            case NodeKind::IDENTIFIER:
+                ok = symbol(n.a);
+                break;
+            case NodeKind::BINARY:
+                ok = child(n.a, i) && child(n.b, i) && n.c <= static_cast<uint32_t>(BinaryOperator::DIVIDE);
+                break;
+            case NodeKind::CALL:
+                ok = child(n.a, i) && list(n.b, n.c, i);
+                break;
+            case NodeKind::EXPRESSION_STATEMENT:
+                ok = child(n.a, i);
+                break;
+            case NodeKind::LET:
+                ok = symbol(n.a) && child(n.b, i);
+                break;
+            case NodeKind::BLOCK:
+            case NodeKind::PROGRAM:
+                ok = list(n.b, n.c, i);
+                break;
+            case NodeKind::FUNCTION:
+                ok = symbol(n.a) && static_cast<uint64_t>(n.b) + 1 + n.c <= flat.lists.size() &&
+                     child(flat.lists[n.b], i);
+                for (uint32_t p = 0; ok && p < n.c; p++) {
+                    ok = symbol(flat.lists[n.b + 1 + p]);
+                }
+                break;
+            case NodeKind::ONCLICK:
+                ok = symbol(n.a) && child(n.b, i);
+                break;
+            case NodeKind::RETURN:
+                ok = optional(n.a, i);
+                break;
+            case NodeKind::IF:
+                ok = child(n.a, i) && child(n.b, i) && optional(n.c, i);
+                break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<Program> loadCachedProgram(const std::string& path, const CacheKey& key) {
+    SourceBuffer file;
+    if (!file.loadFile(path)) {
+        return nullptr;
+    }
+    CacheReader reader(file.view());
+    CacheHeader header;
+    const char* data = reader.take(sizeof(header));
+    if (!data) {
+        return nullptr;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.byteOrder != CACHE_BYTE_ORDER ||
+        header.formatVersion != CACHE_FORMAT_VERSION || header.nodeSize != sizeof(FlatNode) ||
+        header.sourceHash != key.sourceHash || header.configHash != key.configHash || header.nodeCount == 0 ||
+        header.root != header.nodeCount - 1) {
+        return nullptr;
+    }
+
+    auto program = std::make_unique<Program>();
+    FlatAST& flat = program->flat;
+    if (!reader.read(flat.kinds, header.nodeCount)) {
+        return nullptr;
+    }
+    reader.align();
+    for (NodeKind kind : flat.kinds) {
+        if (kind > NodeKind::PROGRAM) {
+            return nullptr;
+        }
+    }
+    if (flat.kinds[header.root] != NodeKind::PROGRAM || !reader.read(flat.nodes, header.nodeCount) ||
+        !reader.read(flat.spans, header.nodeCount) || !reader.read(flat.lists, header.listCount)) {
+        return nullptr;
+    }
+
+    // String literals are copied into the Program's arena in one block, so
+    // the Program does not depend on the mapping staying open
+    std::vector<uint32_t> offsets;
+    std::string_view text;
+    if (!reader.readStrings(header.stringCount, header.stringBytes, offsets, text)) {
+        return nullptr;
+    }
+    std::string_view owned = program->arena.copyString(text);
+    flat.strings.reserve(header.stringCount);
+    for (uint32_t i = 0; i < header.stringCount; i++) {
+        flat.strings.push_back(owned.substr(offsets[i], offsets[i + 1] - offsets[i]));
+    }
+
+    if (!reader.readStrings(header.symbolCount, header.symbolBytes, offsets, text) || !reader.atEnd()) {
+        return nullptr;
+    }
+    SymbolTable& table = symbols();
+    std::vector<Symbol> remap(header.symbolCount);
+    bool identity = true;
+    for (uint32_t i = 0; i < header.symbolCount; i++) {
+        remap[i] = table.intern(text.substr(offsets[i], offsets[i + 1] - offsets[i]));
+        identity = identity && remap[i] == i;
+    }
+
+    if (!validate(flat, header.stringCount, remap, identity)) {
+        return nullptr;
+    }
+    flat.root = header.root;
+    program->nodeCount = header.nodeCount;
+    return program;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "ast.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+constexpr const char* KAROU_VERSION = "1.0";
+
+// Everything a cache entry was produced from. An entry is only used when
+// both halves match the current run.
+struct CacheKey {
+    uint64_t sourceHash;  // the script's bytes
+    uint64_t configHash;  // compiler version, cache format, enabled passes
+};
+
+CacheKey makeCacheKey(std::string_view source, const std::string& configuration);
+
+/**
+ * A .ksc file is the flat AST of one parsed (and optimized) script, laid
+ * out as the arrays FlatAST holds, so loading is a few memcpys from the
+ * mapped file rather than a lex and parse:
+ *
+ *   CacheHeader
+ *   kinds       nodeCount bytes, padded to 4
+ *   nodes       nodeCount FlatNodes
+ *   spans       nodeCount SourceSpans
+ *   lists       listCount uint32s
+ *   strings     stringCount+1 offsets into the string bytes, then the bytes
+ *   symbols     symbolCount+1 offsets into the name bytes, then the bytes
+ *
+ * Symbols are process-local ids, so the entry carries the names. A fresh
+ * process interns them back to the same ids; any other order is fixed up
+ * operand by operand. Everything is native-endian, and the header records
+ * enough to reject a file written by a different layout. Spans are kept
+ * as parsed: a single script is always the first in its run's SourceMap,
+ * so its offsets start at 0 both when it is stored and when it is loaded.
+ *
+ * Bump CACHE_FORMAT_VERSION whenever NodeKind, BinaryOperator, the
+ * meaning of a FlatNode's operands or the sections themselves change.
+ */
+constexpr uint32_t CACHE_FORMAT_VERSION = 3;
+
+// Where the entry for `sourcePath` lives: beside it (hello.ks ->
+// hello.ksc), or in `directory`, named by the source hash, when one is set
+std::string cachePath(const std::string& sourcePath, const std::string& directory, const CacheKey& key);
+
+// A Program holding only its flat AST (its tree is empty), or nullptr if
+// the entry is missing, stale or malformed
+std::unique_ptr<Program> loadCachedProgram(const std::string& path, const CacheKey& key);
+
+// Writes through a temporary file and a rename, so a concurrent reader
+// sees either the old entry or the whole new one. Returns false, with
+// errno set, if the entry could not be written.
+bool storeCachedProgram(const std::string& path, const CacheKey& key, const FlatAST& flat);
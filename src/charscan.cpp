@@ -0,0 +1,333 @@
+#include "charscan.h"
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KAROU_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Scalar reference implementation
+
+static inline bool isWhitespaceByte(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool isIdentifierByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool isDigitByte(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isStringStopByte(unsigned char c) {
+    return c == '"' || c == '\\' || c == 0;
+}
+
+static size_t scalarWhitespaceLength(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && isWhitespaceByte(p[i])) i++;
+    return i;
+}
+
+static size_t scalarIdentifierLength(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && isIdentifierByte(p[i])) i++;
+    return i;
+}
+
+static size_t scalarDigitLength(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && isDigitByte(p[i])) i++;
+    return i;
+}
+
+static size_t scalarFindStringStop(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && !isStringStopByte(p[i])) i++;
+    return i;
+}
+
+static size_t scalarCountNewlines(const char* p, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        count += p[i] == '\n';
+    }
+    return count;
+}
+
+static size_t scalarCollectNewlines(const char* p, size_t n, uint32_t base, uint32_t* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == '\n') {
+            out[count++] = base + static_cast<uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+static const CharScanner scalarScanner = {
+    scalarWhitespaceLength,
+    scalarIdentifierLength,
+    scalarDigitLength,
+    scalarFindStringStop,
+    scalarCountNewlines,
+    scalarCollectNewlines
+};
+
+#ifdef KAROU_SCAN_X86
+
+// Each vector routine builds a "byte is in class" mask for a block and stops
+// at the first block whose mask is not all ones (or, for the stop search, not
+// all zeros). The tail shorter than one block is finished by the scalar code,
+// so nothing is ever read past p + n (the source may be an mmap'd file).
+
+#define KAROU_TARGET_SSE2 __attribute__((target("sse2")))
+#define KAROU_TARGET_AVX2 __attribute__((target("avx2")))
+
+KAROU_TARGET_SSE2 static inline __m128i sse2InRange(__m128i v, char lo, char hi) {
+    // Signed compares are fine: every class bound is ASCII and bytes >= 0x80
+    // compare as negative, so they are never in range.
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+KAROU_TARGET_SSE2 static inline __m128i sse2WhitespaceMask(__m128i v) {
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    return _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+}
+
+KAROU_TARGET_SSE2 static inline __m128i sse2IdentifierMask(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i m = _mm_or_si128(sse2InRange(lower, 'a', 'z'), sse2InRange(v, '0', '9'));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+KAROU_TARGET_SSE2 static inline __m128i sse2StopMask(__m128i v) {
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+}
+
+#define KAROU_SSE2_SPAN(name, maskExpr, scalarTail)                                   \
+    KAROU_TARGET_SSE2 static size_t name(const char* p, size_t n) {                   \
+        size_t i = 0;                                                                  \
+        for (; i + 16 <= n; i += 16) {                                                 \
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));      \
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(maskExpr));        \
+            if (mask != 0xFFFFu) {                                                     \
+                return i + static_cast<size_t>(__builtin_ctz(~mask));                  \
+            }                                                                          \
+        }                                                                              \
+        return i + scalarTail(p + i, n - i);                                           \
+    }
+
+KAROU_SSE2_SPAN(sse2WhitespaceLength, sse2WhitespaceMask(v), scalarWhitespaceLength)
+KAROU_SSE2_SPAN(sse2IdentifierLength, sse2IdentifierMask(v), scalarIdentifierLength)
+KAROU_SSE2_SPAN(sse2DigitLength, sse2InRange(v, '0', '9'), scalarDigitLength)
+
+KAROU_TARGET_SSE2 static size_t sse2FindStringStop(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(sse2StopMask(v)));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+    return i + scalarFindStringStop(p + i, n - i);
+}
+
+KAROU_TARGET_SSE2 static size_t sse2CountNewlines(const char* p, size_t n) {
+    size_t count = 0;
+    size_t i = 0;
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        count += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))));
+    }
+    return count + scalarCountNewlines(p + i, n - i);
+}
+
+KAROU_TARGET_SSE2 static size_t sse2CollectNewlines(const char* p, size_t n, uint32_t base, uint32_t* out) {
+    size_t count = 0;
+    size_t i = 0;
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        while (mask) {
+            out[count++] = base + static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count + scalarCollectNewlines(p + i, n - i, base + static_cast<uint32_t>(i), out + count);
+}
+
+static const CharScanner sse2Scanner = {
+    sse2WhitespaceLength,
+    sse2IdentifierLength,
+    sse2DigitLength,
+    sse2FindStringStop,
+    sse2CountNewlines,
+    sse2CollectNewlines
+};
+
+KAROU_TARGET_AVX2 static inline __m256i avx2InRange(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+KAROU_TARGET_AVX2 static inline __m256i avx2WhitespaceMask(__m256i v) {
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    return _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+}
+
+KAROU_TARGET_AVX2 static inline __m256i avx2IdentifierMask(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i m = _mm256_or_si256(avx2InRange(lower, 'a', 'z'), avx2InRange(v, '0', '9'));
+    return _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+KAROU_TARGET_AVX2 static inline __m256i avx2StopMask(__m256i v) {
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    return _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+}
+
+#define KAROU_AVX2_SPAN(name, maskExpr, sse2Tail)                                     \
+    KAROU_TARGET_AVX2 static size_t name(const char* p, size_t n) {                   \
+        size_t i = 0;                                                                  \
+        for (; i + 32 <= n; i += 32) {                                                 \
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));   \
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(maskExpr));     \
+            if (mask != 0xFFFFFFFFu) {                                                 \
+                return i + static_cast<size_t>(__builtin_ctz(~mask));                  \
+            }                                                                          \
+        }                                                                              \
+        return i + sse2Tail(p + i, n - i);                                             \
+    }
+
+KAROU_AVX2_SPAN(avx2WhitespaceLength, avx2WhitespaceMask(v), sse2WhitespaceLength)
+KAROU_AVX2_SPAN(avx2IdentifierLength, avx2IdentifierMask(v), sse2IdentifierLength)
+KAROU_AVX2_SPAN(avx2DigitLength, avx2InRange(v, '0', '9'), sse2DigitLength)
+
+KAROU_TARGET_AVX2 static size_t avx2FindStringStop(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(avx2StopMask(v)));
+        if (mask != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+    return i + sse2FindStringStop(p + i, n - i);
+}
+
+KAROU_TARGET_AVX2 static size_t avx2CountNewlines(const char* p, size_t n) {
+    size_t count = 0;
+    size_t i = 0;
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        count += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)))));
+    }
+    return count + sse2CountNewlines(p + i, n - i);
+}
+
+KAROU_TARGET_AVX2 static size_t avx2CollectNewlines(const char* p, size_t n, uint32_t base, uint32_t* out) {
+    size_t count = 0;
+    size_t i = 0;
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        while (mask) {
+            out[count++] = base + static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count + sse2CollectNewlines(p + i, n - i, base + static_cast<uint32_t>(i), out + count);
+}
+
+static const CharScanner avx2Scanner = {
+    avx2WhitespaceLength,
+    avx2IdentifierLength,
+    avx2DigitLength,
+    avx2FindStringStop,
+    avx2CountNewlines,
+    avx2CollectNewlines
+};
+
+#endif // KAROU_SCAN_X86
+
+bool scanModeSupported(ScanMode mode) {
+#ifdef KAROU_SCAN_X86
+    // Required because this may run from a static initializer, before main.
+    __builtin_cpu_init();
+#endif
+    switch (mode) {
+        case ScanMode::SCALAR:
+            return true;
+#ifdef KAROU_SCAN_X86
+        case ScanMode::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ScanMode::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static const CharScanner& scannerFor(ScanMode mode) {
+    switch (mode) {
+#ifdef KAROU_SCAN_X86
+        case ScanMode::AVX2: return avx2Scanner;
+        case ScanMode::SSE2: return sse2Scanner;
+#endif
+        default: return scalarScanner;
+    }
+}
+
+static ScanMode detectScanMode() {
+    if (const char* forced = std::getenv("KAROU_SCAN")) {
+        ScanMode modes[] = {ScanMode::SCALAR, ScanMode::SSE2, ScanMode::AVX2};
+        for (ScanMode mode : modes) {
+            if (std::strcmp(forced, scanModeName(mode)) == 0 && scanModeSupported(mode)) {
+                return mode;
+            }
+        }
+    }
+    if (scanModeSupported(ScanMode::AVX2)) return ScanMode::AVX2;
+    if (scanModeSupported(ScanMode::SSE2)) return ScanMode::SSE2;
+    return ScanMode::SCALAR;
+}
+
+static ScanMode currentMode = detectScanMode();
+static const CharScanner* currentScanner = &scannerFor(currentMode);
+
+const CharScanner& charScanner() {
+    return *currentScanner;
+}
+
+ScanMode scanMode() {
+    return currentMode;
+}
+
+bool setScanMode(ScanMode mode) {
+    if (!scanModeSupported(mode)) {
+        return false;
+    }
+    currentMode = mode;
+    currentScanner = &scannerFor(mode);
+    return true;
+}
+
+const char* scanModeName(ScanMode mode) {
+    switch (mode) {
+        case ScanMode::SCALAR: return "scalar";
+        case ScanMode::SSE2: return "sse2";
+        case ScanMode::AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
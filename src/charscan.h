@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bulk character classification used by the Lexer. Each routine looks at
+ * [p, p + n) and returns how many leading bytes belong to the class (or, for
+ * findStringStop, the index of the first byte that ends a plain string run).
+ *
+ * Implementations exist for SSE2, AVX2 and plain scalar code; the widest one
+ * the CPU supports is picked on first use. KAROU_SCAN=scalar|sse2|avx2 in the
+ * environment, or setScanMode(), overrides the choice.
+ */
+enum class ScanMode {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+struct CharScanner {
+    // ' ', '\t', '\n', '\r'
+    size_t (*whitespaceLength)(const char* p, size_t n);
+    // [A-Za-z0-9_]
+    size_t (*identifierLength)(const char* p, size_t n);
+    // [0-9]
+    size_t (*digitLength)(const char* p, size_t n);
+    // Index of the first '"', '\\' or NUL byte, or n if there is none
+    size_t (*findStringStop)(const char* p, size_t n);
+    // Number of '\n' bytes
+    size_t (*countNewlines)(const char* p, size_t n);
+    // Write base + i for every '\n' at p[i] to out (which must have room for
+    // countNewlines(p, n) entries); returns the number written
+    size_t (*collectNewlines)(const char* p, size_t n, uint32_t base, uint32_t* out);
+};
+
+const CharScanner& charScanner();
+ScanMode scanMode();
+bool scanModeSupported(ScanMode mode);
+// Returns false (and leaves the current mode alone) if the CPU lacks `mode`.
+bool setScanMode(ScanMode mode);
+const char* scanModeName(ScanMode mode);
@@ -1,41 +1,142 @@
+#include "cache.h"
 #include "lexer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "optimizer.h"
+#include "project.h"
+#include "source.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 
 class KarouCompiler {
 private:
-    std::string sourceCode;
+    // Owns the script text. The lexer and parser only ever hold views into it.
+    SourceBuffer source;
+    uint32_t sourceBase = 0;  // where `source` sits in `sources`
+    // Every script run so far, for runtime errors to name the line they hit
+    SourceMap sources;
+    // The scripts of a multi-file build; `ast` then points into their Programs
+    std::vector<SourceFile> files;
+    // Registered onClick handlers run bytecode the interpreter keeps, so a
+    // Program can be dropped once it has run
     std::unique_ptr<Program> ast;
     Interpreter interpreter;
+    Optimizer optimizer;
     
 public:
-    bool loadFile(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Error: Could not open file '" << filename << "'" << std::endl;
+    KarouCompiler() {
+        interpreter.setSourceMap(&sources);
+    }
+    
+    bool loadFile(const std::string& filename, bool showStats = false) {
+        auto start = std::chrono::steady_clock::now();
+        
+        if (!source.loadFile(filename)) {
+            std::cerr << "Error: Could not open file '" << filename << "': " << std::strerror(errno) << std::endl;
             return false;
         }
+        sourceBase = sources.add(filename, static_cast<uint32_t>(source.size()), source.view());
         
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        sourceCode = buffer.str();
-        file.close();
+        if (showStats) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cerr << "[stats] loaded " << source.size() << " bytes from '" << filename << "' via "
+                      << (source.isMapped() ? "mmap" : "read") << " in " << elapsed.count() << " ms" << std::endl;
+        }
         
         return true;
     }
     
-    bool loadString(const std::string& code) {
-        sourceCode = code;
+    // `name` stands in for a path in runtime errors. The map keeps its own
+    // copy, since the next string replaces `source`.
+    bool loadString(const std::string& code, const std::string& name) {
+        source.assign(code);
+        sourceBase = sources.add(name, static_cast<uint32_t>(code.size()), code, true);
         return true;
     }
     
     bool parse() {
-        Parser parser(sourceCode);
+        Parser parser(source.view(), sourceBase);
         ast = parser.parseProgram();
+        return reportErrors(parser);
+    }
+    
+    // Lex and parse a file in fixed-size chunks without ever holding all of
+    // it in memory. Only the AST outlives the call.
+    bool parseStream(const std::string& filename, size_t chunkSize, bool showStats = false) {
+        auto start = std::chrono::steady_clock::now();
+        
+        ChunkedSource chunks(chunkSize);
+        if (!chunks.open(filename)) {
+            std::cerr << "Error: Could not open file '" << filename << "': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        
+        // The streamed script's size is only known once it has been read;
+        // it is the run's only script, so it starts at offset 0
+        StreamingLexer lexer(chunks);
+        Parser parser(lexer);
+        ast = parser.parseProgram();
+        sources.add(filename, static_cast<uint32_t>(chunks.totalBytes()));
+        
+        if (showStats) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cerr << "[stats] streamed " << chunks.totalBytes() << " bytes from '" << filename << "' in "
+                      << chunkSize << "-byte chunks, peak window " << chunks.peakWindowSize()
+                      << " bytes, lex+parse " << elapsed.count() << " ms" << std::endl;
+        }
+        
+        return reportErrors(parser);
+    }
+    
+    // Parse several scripts at once and run them as one program, in the
+    // order given
+    bool parseFiles(const std::vector<std::string>& paths, unsigned threads, bool showStats = false) {
+        auto start = std::chrono::steady_clock::now();
+        
+        files = std::vector<SourceFile>(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+            files[i].path = paths[i];
+        }
+        ::parseFiles(files, sources, threads);
+        
+        bool ok = true;
+        for (const SourceFile& file : files) {
+            if (!file.errors.empty()) {
+                std::cerr << "Errors in '" << file.path << "':" << std::endl;
+                for (const auto& error : file.errors) {
+                    std::cerr << "  " << error << std::endl;
+                }
+                ok = false;
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+        ast = mergePrograms(files);
+        
+        if (showStats) {
+            size_t totalBytes = 0;
+            for (const SourceFile& file : files) {
+                std::cerr << "[stats] parsed '" << file.path << "': " << file.source.size() << " bytes, "
+                          << file.program->nodeCount << " nodes in " << file.milliseconds << " ms on worker "
+                          << file.worker << std::endl;
+                totalBytes += file.source.size();
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cerr << "[stats] " << files.size() << " files, " << totalBytes << " bytes, " << ast->nodeCount
+                      << " nodes parsed and merged on " << std::min<size_t>(threads, files.size())
+                      << " threads in " << elapsed.count() << " ms" << std::endl;
+        }
         
+        return true;
+    }
+    
+    bool reportErrors(const Parser& parser) {
         auto errors = parser.getErrors();
         if (!errors.empty()) {
             std::cerr << "Parse errors:" << std::endl;
@@ -48,17 +149,97 @@ public:
         return true;
     }
     
+    Optimizer& getOptimizer() {
+        return optimizer;
+    }
+    
+    // Interactive lines are not whole programs: a name one line binds can
+    // be rebound by the next, so only binding-free rewrites apply there
+    void optimize(bool wholeProgram, bool showStats = false) {
+        if (!ast) {
+            return;
+        }
+        auto stats = optimizer.run(*ast, wholeProgram);
+        if (showStats) {
+            for (const PassStats& pass : stats) {
+                std::cerr << "[stats] pass " << pass.name << ": " << pass.rewrites << " rewrites in "
+                          << pass.milliseconds << " ms" << std::endl;
+            }
+        }
+    }
+    
+    // Identifies the loaded source under the current pass settings
+    CacheKey cacheKey() const {
+        return makeCacheKey(source.view(), optimizer.enabledPassNames());
+    }
+    
+    // Stands in for parse() and optimize() when the entry matches
+    bool loadCache(const std::string& path, const CacheKey& key, bool showStats = false) {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<Program> cached = loadCachedProgram(path, key);
+        
+        if (showStats) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cerr << "[stats] cache " << (cached ? "hit" : "miss") << " '" << path << "' in "
+                      << elapsed.count() << " ms" << std::endl;
+        }
+        
+        if (!cached) {
+            return false;
+        }
+        ast = std::move(cached);
+        return true;
+    }
+    
+    // A cache that cannot be written (read-only directory, say) only costs
+    // the next run a parse, so failures are reported with -s and otherwise ignored
+    void storeCache(const std::string& path, const CacheKey& key, bool showStats = false) {
+        if (!ast) {
+            return;
+        }
+        bool stored = storeCachedProgram(path, key, ast->flat);
+        if (showStats) {
+            if (stored) {
+                std::cerr << "[stats] cache wrote '" << path << "'" << std::endl;
+            } else {
+                std::cerr << "[stats] cache could not write '" << path << "': " << std::strerror(errno) << std::endl;
+            }
+        }
+    }
+    
+    void printOptimizedAST() {
+        if (ast) {
+            std::cout << "=== Optimized Syntax Tree ===" << std::endl;
+            ast->flat.print(std::cout);
+            std::cout << std::endl;
+        }
+    }
+    
     void printAST() {
         if (ast) {
             std::cout << "=== Abstract Syntax Tree ===" << std::endl;
-            std::cout << ast->toString() << std::endl;
+            ast->flat.print(std::cout);
+            std::cout << std::endl;
         }
     }
     
-    void run() {
+    // The tree alone on stdout, without banners, for other tools to read
+    void printJsonAST() {
         if (ast) {
+            ast->flat.printJson(std::cout);
+            std::cout << std::endl;
+        }
+    }
+    
+    void run(bool dumpBytecode = false) {
+        if (ast) {
+            Chunk& chunk = interpreter.compile(ast->flat);
+            if (dumpBytecode) {
+                std::cout << "=== Bytecode ===" << std::endl;
+                chunk.disassemble(std::cout);
+            }
             std::cout << "=== Execution Output ===" << std::endl;
-            interpreter.interpret(*ast);
+            interpreter.run(chunk);
         }
     }
     
@@ -69,12 +250,26 @@ public:
 
 void printUsage(const char* programName) {
     std::cout << "Karou Script Compiler v1.0" << std::endl;
-    std::cout << "Usage: " << programName << " [options] <file.ks>" << std::endl;
+    std::cout << "Usage: " << programName << " [options] <file.ks | directory>..." << std::endl;
     std::cout << "Options:" << std::endl;
     std::cout << "  -h, --help     Show this help message" << std::endl;
     std::cout << "  -a, --ast      Print the Abstract Syntax Tree" << std::endl;
+    std::cout << "  --ast=json     Print the tree as JSON, without running the program" << std::endl;
     std::cout << "  -i, --interactive  Run in interactive mode" << std::endl;
     std::cout << "  -e, --eval <code>  Evaluate code directly" << std::endl;
+    std::cout << "  -s, --stats    Report bytes loaded and load time on stderr" << std::endl;
+    std::cout << "  --stream[=BYTES]   Lex and parse the file in chunks (default 65536) in bounded memory" << std::endl;
+    std::cout << "  -O0            Run the program exactly as parsed, without optimization passes" << std::endl;
+    std::cout << "  --disable-pass=NAME[,NAME]  Skip optimization passes (fold, propagate, dce)" << std::endl;
+    std::cout << "  --dump-optimized   Print the tree after optimization" << std::endl;
+    std::cout << "  --dump-bytecode    Print the compiled bytecode before running it" << std::endl;
+    std::cout << "  --no-cache     Neither read nor write the precompiled .ksc cache" << std::endl;
+    std::cout << "  --recache      Parse even if a cache entry matches, and rewrite it" << std::endl;
+    std::cout << "  --cache-dir=DIR    Keep cache entries in DIR instead of beside each script" << std::endl;
+    std::cout << "  --manifest=FILE    Also compile the scripts FILE lists, one path per line" << std::endl;
+    std::cout << "  -j, --jobs N   Parse several files on N threads (default: one per core)" << std::endl;
+    std::cout << "Several files, or a directory of .ks files, run as one program in the order given." << std::endl;
+    std::cout << "Use '-' as the file name to read the script from stdin." << std::endl;
 }
 
 void interactiveMode() {
@@ -83,10 +278,12 @@ void interactiveMode() {
     
     KarouCompiler compiler;
     std::string input;
+    size_t lineNumber = 0;
     
     while (true) {
         std::cout << "karou> ";
         std::getline(std::cin, input);
+        lineNumber++;
         
         if (input == "exit" || input == "quit") {
             break;
@@ -109,7 +306,8 @@ void interactiveMode() {
         
         if (input.empty()) continue;
         
-        if (compiler.loadString(input) && compiler.parse()) {
+        if (compiler.loadString(input, "<line " + std::to_string(lineNumber) + ">") && compiler.parse()) {
+            compiler.optimize(false);
             compiler.run();
         }
     }
@@ -122,10 +320,22 @@ int main(int argc, char* argv[]) {
     }
     
     bool showAST = false;
+    bool jsonAST = false;
     bool interactive = false;
-    std::string filename;
+    bool showStats = false;
+    bool dumpOptimized = false;
+    bool dumpBytecode = false;
+    bool useCache = true;
+    bool recache = false;
+    std::string cacheDir;
+    size_t streamChunkSize = 0;
+    unsigned jobs = ThreadPool::hardwareThreads();
+    std::vector<std::string> inputs;
+    std::vector<std::string> manifests;
     std::string evalCode;
     
+    KarouCompiler compiler;
+    
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -133,8 +343,55 @@ int main(int argc, char* argv[]) {
         if (arg == "-h" || arg == "--help") {
             printUsage(argv[0]);
             return 0;
-        } else if (arg == "-a" || arg == "--ast") {
+        } else if (arg == "-a" || arg == "--ast" || arg == "--ast=text") {
+            showAST = true;
+        } else if (arg == "--ast=json") {
             showAST = true;
+            jsonAST = true;
+        } else if (arg == "-s" || arg == "--stats") {
+            showStats = true;
+        } else if (arg == "--stream") {
+            streamChunkSize = ChunkedSource::DEFAULT_CHUNK_SIZE;
+        } else if (arg.rfind("--stream=", 0) == 0) {
+            streamChunkSize = std::strtoul(arg.c_str() + 9, nullptr, 10);
+            if (streamChunkSize == 0) {
+                std::cerr << "Error: --stream needs a positive chunk size" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-O0") {
+            compiler.getOptimizer().disableAll();
+        } else if (arg.rfind("--disable-pass=", 0) == 0) {
+            std::string names = arg.substr(15);
+            size_t start = 0;
+            while (start <= names.size()) {
+                size_t comma = std::min(names.find(',', start), names.size());
+                std::string name = names.substr(start, comma - start);
+                if (!compiler.getOptimizer().disable(name)) {
+                    std::cerr << "Error: Unknown optimization pass '" << name << "' (passes: "
+                              << compiler.getOptimizer().passNames() << ")" << std::endl;
+                    return 1;
+                }
+                start = comma + 1;
+            }
+        } else if (arg == "--dump-optimized") {
+            dumpOptimized = true;
+        } else if (arg == "--dump-bytecode") {
+            dumpBytecode = true;
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg == "--recache") {
+            recache = true;
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            cacheDir = arg.substr(12);
+        } else if (arg.rfind("--manifest=", 0) == 0) {
+            manifests.push_back(arg.substr(11));
+        } else if (arg == "-j" || arg == "--jobs" || arg.rfind("--jobs=", 0) == 0) {
+            const char* count = arg[1] == 'j' || arg == "--jobs" ? (i + 1 < argc ? argv[++i] : "") : arg.c_str() + 7;
+            jobs = static_cast<unsigned>(std::strtoul(count, nullptr, 10));
+            if (jobs == 0) {
+                std::cerr << "Error: " << arg << " needs a positive thread count" << std::endl;
+                return 1;
+            }
         } else if (arg == "-i" || arg == "--interactive") {
             interactive = true;
         } else if (arg == "-e" || arg == "--eval") {
@@ -144,8 +401,8 @@ int main(int argc, char* argv[]) {
                 std::cerr << "Error: --eval requires code argument" << std::endl;
                 return 1;
             }
-        } else if (arg[0] != '-') {
-            filename = arg;
+        } else if (arg == "-" || arg[0] != '-') {
+            inputs.push_back(arg);
         }
     }
     
@@ -154,39 +411,116 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
-    KarouCompiler compiler;
-    
     // Handle direct code evaluation
     if (!evalCode.empty()) {
-        if (compiler.loadString(evalCode) && compiler.parse()) {
+        if (compiler.loadString(evalCode, "<eval>") && compiler.parse()) {
+            if (jsonAST) {
+                compiler.printJsonAST();
+                return 0;
+            }
             if (showAST) {
                 compiler.printAST();
             }
-            compiler.run();
+            compiler.optimize(true, showStats);
+            if (dumpOptimized) {
+                compiler.printOptimizedAST();
+            }
+            compiler.run(dumpBytecode);
         }
         return 0;
     }
     
     // Handle file compilation
-    if (filename.empty()) {
+    std::vector<std::string> paths;
+    if (!collectSources(inputs, paths)) {
+        return 1;
+    }
+    for (const std::string& manifest : manifests) {
+        if (!readManifest(manifest, paths)) {
+            return 1;
+        }
+    }
+    if (paths.empty()) {
         std::cerr << "Error: No input file specified" << std::endl;
         printUsage(argv[0]);
         return 1;
     }
     
-    if (!compiler.loadFile(filename)) {
-        return 1;
+    // A single script keeps the streaming and cache paths below. Several
+    // are parsed in parallel and merged; cache entries are per script and
+    // already optimized, which would drop a let only another file reads.
+    bool multiFile = paths.size() > 1 || !manifests.empty() || (inputs.size() == 1 && paths[0] != inputs[0]);
+    if (multiFile) {
+        if (streamChunkSize > 0) {
+            std::cerr << "Error: --stream takes a single file" << std::endl;
+            return 1;
+        }
+        if (!compiler.parseFiles(paths, jobs, showStats)) {
+            return 1;
+        }
+        if (jsonAST) {
+            compiler.printJsonAST();
+            return 0;
+        }
+        if (showAST) {
+            compiler.printAST();
+        }
+        compiler.optimize(true, showStats);
+        if (dumpOptimized) {
+            compiler.printOptimizedAST();
+        }
+        compiler.run(dumpBytecode);
+        return 0;
     }
+    const std::string& filename = paths[0];
     
-    if (!compiler.parse()) {
-        return 1;
+    bool fromCache = false;
+    std::string cacheFile;
+    CacheKey cacheKey = {};
+    
+    if (streamChunkSize > 0) {
+        if (!compiler.parseStream(filename, streamChunkSize, showStats)) {
+            return 1;
+        }
+    } else {
+        if (!compiler.loadFile(filename, showStats)) {
+            return 1;
+        }
+        
+        // Stdin has no path to keep an entry beside, and -a wants the tree
+        // as parsed, which an entry no longer holds
+        if (useCache && filename != "-") {
+            cacheKey = compiler.cacheKey();
+            cacheFile = cachePath(filename, cacheDir, cacheKey);
+            fromCache = !recache && !showAST && compiler.loadCache(cacheFile, cacheKey, showStats);
+        }
+        
+        if (!fromCache && !compiler.parse()) {
+            return 1;
+        }
+    }
+    
+    if (jsonAST) {
+        compiler.printJsonAST();
+        return 0;
+    }
+    
+    if (!fromCache) {
+        if (showAST) {
+            compiler.printAST();
+        }
+        
+        compiler.optimize(true, showStats);
+        if (!cacheFile.empty()) {
+            compiler.storeCache(cacheFile, cacheKey, showStats);
+        }
     }
     
-    if (showAST) {
-        compiler.printAST();
+    if (dumpOptimized) {
+        compiler.printOptimizedAST();
     }
     
-    compiler.run();
+    compiler.run(dumpBytecode);
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,738 @@
+#include "flat_ast.h"
+#include "ast.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <ostream>
+#include <sstream>
+
+// Walks the pointer tree once, appending each node after its children.
+// Recursion is cheapest for ordinary trees; below RECURSION_LIMIT the walk
+// switches to its own stack, so a tree of any depth (a left-leaning chain
+// of a million additions, say) flattens in bounded native stack.
+class FlatBuilder {
+private:
+    // A node whose children are being flattened, left to right
+    struct Visit {
+        const ASTNode* node;
+        uint32_t next;  // the child to flatten next
+        uint32_t count;  // how many children it has
+    };
+
+    FlatAST& flat;
+    std::vector<Visit> stack;
+    std::vector<uint32_t> results;  // indices of finished children, stacked
+
+    NodeIndex append(NodeKind kind, uint32_t a, uint32_t b = 0, uint32_t c = 0) {
+        flat.kinds.push_back(kind);
+        flat.nodes.push_back(FlatNode{a, b, c});
+        return static_cast<NodeIndex>(flat.kinds.size() - 1);
+    }
+
+    uint32_t popResult() {
+        uint32_t index = results.back();
+        results.pop_back();
+        return index;
+    }
+
+    // Move the last `count` results into `lists`; returns where they start
+    uint32_t commitList(size_t count) {
+        uint32_t start = static_cast<uint32_t>(flat.lists.size());
+        flat.lists.insert(flat.lists.end(), results.end() - count, results.end());
+        results.resize(results.size() - count);
+        return start;
+    }
+
+    static uint32_t childCount(const ASTNode* node) {
+        switch (node->kind) {
+            case NodeKind::BINARY:
+                return 2;
+            case NodeKind::CALL:
+                return 1 + static_cast<const CallExpression*>(node)->arguments.size();
+            case NodeKind::EXPRESSION_STATEMENT:
+            case NodeKind::LET:
+            case NodeKind::FUNCTION:
+            case NodeKind::ONCLICK:
+            case NodeKind::RETURN:
+                return 1;
+            case NodeKind::IF:
+                return 3;
+            case NodeKind::BLOCK:
+                return static_cast<const BlockStatement*>(node)->statements.size();
+            case NodeKind::PROGRAM:
+                return static_cast<const Program*>(node)->statements.size();
+            default:
+                return 0;
+        }
+    }
+
+    // The i'th child in the order finish() expects them; nullptr if missing
+    static const ASTNode* childAt(const ASTNode* node, uint32_t i) {
+        switch (node->kind) {
+            case NodeKind::BINARY: {
+                auto* binary = static_cast<const BinaryExpression*>(node);
+                return i == 0 ? binary->left : binary->right;
+            }
+            case NodeKind::CALL: {
+                auto* call = static_cast<const CallExpression*>(node);
+                return i == 0 ? call->function : call->arguments[i - 1];
+            }
+            case NodeKind::EXPRESSION_STATEMENT:
+                return static_cast<const ExpressionStatement*>(node)->expression;
+            case NodeKind::LET:
+                return static_cast<const LetStatement*>(node)->value;
+            case NodeKind::BLOCK:
+                return static_cast<const BlockStatement*>(node)->statements[i];
+            case NodeKind::FUNCTION:
+                return static_cast<const FunctionDeclaration*>(node)->body;
+            case NodeKind::ONCLICK:
+                return static_cast<const OnClickStatement*>(node)->body;
+            case NodeKind::RETURN:
+                return static_cast<const ReturnStatement*>(node)->value;
+            case NodeKind::IF: {
+                auto* branch = static_cast<const IfStatement*>(node);
+                return i == 0 ? branch->condition : i == 1 ? static_cast<const ASTNode*>(branch->consequence)
+                                                           : branch->alternative;
+            }
+            case NodeKind::PROGRAM:
+                return static_cast<const Program*>(node)->statements[i];
+            default:
+                return nullptr;
+        }
+    }
+
+    // Append a node whose children are all on `results`
+    NodeIndex finish(const ASTNode* node) {
+        flat.spans.push_back(node->span());
+        switch (node->kind) {
+            case NodeKind::NUMBER: {
+                uint64_t bits;
+                std::memcpy(&bits, &static_cast<const NumberLiteral*>(node)->value, sizeof(bits));
+                return append(NodeKind::NUMBER, static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32));
+            }
+            case NodeKind::INTEGER: {
+                uint64_t bits = static_cast<uint64_t>(static_cast<const IntegerLiteral*>(node)->value);
+                return append(NodeKind::INTEGER, static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32));
+            }
+            case NodeKind::STRING:
+                flat.strings.push_back(static_cast<const StringLiteral*>(node)->value);
+                return append(NodeKind::STRING, static_cast<uint32_t>(flat.strings.size() - 1));
+            case NodeKind::IDENTIFIER:
+                return append(NodeKind::IDENTIFIER, static_cast<const Identifier*>(node)->name);
+            case NodeKind::BINARY: {
+                NodeIndex right = popResult();
+                NodeIndex left = popResult();
+                return append(NodeKind::BINARY, left, right,
+                              static_cast<uint32_t>(static_cast<const BinaryExpression*>(node)->operator_));
+            }
+            case NodeKind::CALL: {
+                uint32_t count = static_cast<const CallExpression*>(node)->arguments.size();
+                uint32_t start = commitList(count);
+                return append(NodeKind::CALL, popResult(), start, count);
+            }
+            case NodeKind::EXPRESSION_STATEMENT:
+                return append(NodeKind::EXPRESSION_STATEMENT, popResult());
+            case NodeKind::LET:
+                return append(NodeKind::LET, static_cast<const LetStatement*>(node)->name, popResult());
+            case NodeKind::BLOCK: {
+                uint32_t count = static_cast<const BlockStatement*>(node)->statements.size();
+                return append(NodeKind::BLOCK, 0, commitList(count), count);
+            }
+            case NodeKind::FUNCTION: {
+                auto* func = static_cast<const FunctionDeclaration*>(node);
+                uint32_t start = static_cast<uint32_t>(flat.lists.size());
+                flat.lists.push_back(popResult());
+                flat.lists.insert(flat.lists.end(), func->parameters.begin(), func->parameters.end());
+                return append(NodeKind::FUNCTION, func->name, start, func->parameters.size());
+            }
+            case NodeKind::ONCLICK:
+                return append(NodeKind::ONCLICK, static_cast<const OnClickStatement*>(node)->elementId, popResult());
+            case NodeKind::RETURN:
+                return append(NodeKind::RETURN, popResult());
+            case NodeKind::IF: {
+                NodeIndex alternative = popResult();
+                NodeIndex consequence = popResult();
+                return append(NodeKind::IF, popResult(), consequence, alternative);
+            }
+            case NodeKind::PROGRAM: {
+                uint32_t count = static_cast<const Program*>(node)->statements.size();
+                return append(NodeKind::PROGRAM, 0, commitList(count), count);
+            }
+        }
+        return NO_NODE;
+    }
+
+    // Past this depth the walk stops recursing and keeps its own stack
+    static constexpr size_t RECURSION_LIMIT = 4096;
+
+    void walk(const ASTNode* node, size_t depth) {
+        if (!node) {
+            results.push_back(NO_NODE);
+            return;
+        }
+        if (depth == RECURSION_LIMIT) {
+            walkIteratively(node);
+            return;
+        }
+        uint32_t count = childCount(node);
+        for (uint32_t i = 0; i < count; i++) {
+            walk(childAt(node, i), depth + 1);
+        }
+        results.push_back(finish(node));
+    }
+
+    void walkIteratively(const ASTNode* root) {
+        stack.push_back(Visit{root, 0, childCount(root)});
+        while (!stack.empty()) {
+            Visit& top = stack.back();
+            if (top.next == top.count) {
+                const ASTNode* node = top.node;
+                stack.pop_back();
+                results.push_back(finish(node));
+                continue;
+            }
+            const ASTNode* child = childAt(top.node, top.next++);
+            if (!child) {
+                results.push_back(NO_NODE);
+            } else if (child->kind <= NodeKind::IDENTIFIER) {
+                // Literals and identifiers have no children to wait for
+                results.push_back(finish(child));
+            } else {
+                stack.push_back(Visit{child, 0, childCount(child)});
+            }
+        }
+    }
+
+public:
+    explicit FlatBuilder(FlatAST& flat) : flat(flat) {}
+
+    void build(const Program& program) { walk(&program, 0); }
+};
+
+FlatAST FlatAST::build(const Program& program) {
+    FlatAST flat;
+    flat.kinds.reserve(program.nodeCount);
+    flat.nodes.reserve(program.nodeCount);
+    flat.spans.reserve(program.nodeCount);
+    FlatBuilder(flat).build(program);
+    flat.root = static_cast<NodeIndex>(flat.kinds.size() - 1);
+    return flat;
+}
+
+FlatAST FlatAST::concatenate(const std::vector<const FlatAST*>& parts) {
+    FlatAST merged;
+    size_t nodes = 1;
+    size_t lists = 0;
+    size_t strings = 0;
+    for (const FlatAST* part : parts) {
+        nodes += part->size() - 1;
+        lists += part->lists.size();
+        strings += part->strings.size();
+    }
+    merged.kinds.reserve(nodes);
+    merged.nodes.reserve(nodes);
+    merged.spans.reserve(nodes);
+    merged.lists.reserve(lists);
+    merged.strings.reserve(strings);
+
+    std::vector<uint32_t> statements;
+    for (const FlatAST* part : parts) {
+        const uint32_t nodeBase = static_cast<uint32_t>(merged.size());
+        const uint32_t listBase = static_cast<uint32_t>(merged.lists.size());
+        const uint32_t stringBase = static_cast<uint32_t>(merged.strings.size());
+        auto shift = [nodeBase](uint32_t index) { return index == NO_NODE ? NO_NODE : index + nodeBase; };
+        auto shiftList = [&](uint32_t start, uint32_t count) {
+            for (uint32_t i = start; i < start + count; i++) {
+                merged.lists[i] = shift(merged.lists[i]);
+            }
+        };
+
+        merged.lists.insert(merged.lists.end(), part->lists.begin(), part->lists.end());
+        merged.strings.insert(merged.strings.end(), part->strings.begin(), part->strings.end());
+        // Every node but the part's root, which is its Program
+        merged.kinds.insert(merged.kinds.end(), part->kinds.begin(), part->kinds.begin() + part->root);
+        merged.nodes.insert(merged.nodes.end(), part->nodes.begin(), part->nodes.begin() + part->root);
+        merged.spans.insert(merged.spans.end(), part->spans.begin(), part->spans.begin() + part->root);
+        for (NodeIndex i = nodeBase; i < merged.size(); i++) {
+            FlatNode& n = merged.nodes[i];
+            switch (merged.kinds[i]) {
+                case NodeKind::NUMBER:
+                case NodeKind::INTEGER:
+                case NodeKind::IDENTIFIER:
+                case NodeKind::PROGRAM:
+                    break;
+                case NodeKind::STRING:
+                    n.a += stringBase;
+                    break;
+                case NodeKind::BINARY:
+                    n.a = shift(n.a);
+                    n.b = shift(n.b);
+                    break;
+                case NodeKind::CALL:
+                    n.a = shift(n.a);
+                    n.b += listBase;
+                    shiftList(n.b, n.c);
+                    break;
+                case NodeKind::EXPRESSION_STATEMENT:
+                case NodeKind::RETURN:
+                    n.a = shift(n.a);
+                    break;
+                case NodeKind::IF:
+                    n.a = shift(n.a);
+                    n.b = shift(n.b);
+                    n.c = shift(n.c);
+                    break;
+                case NodeKind::LET:
+                case NodeKind::ONCLICK:
+                    n.b = shift(n.b);
+                    break;
+                case NodeKind::BLOCK:
+                    n.b += listBase;
+                    shiftList(n.b, n.c);
+                    break;
+                case NodeKind::FUNCTION:
+                    n.b += listBase;
+                    shiftList(n.b, 1);  // the body; parameters are Symbols
+                    break;
+            }
+        }
+
+        const FlatNode& program = part->nodes[part->root];
+        for (uint32_t i = 0; i < program.c; i++) {
+            statements.push_back(shift(part->lists[program.b + i]));
+        }
+    }
+
+    uint32_t start = static_cast<uint32_t>(merged.lists.size());
+    merged.lists.insert(merged.lists.end(), statements.begin(), statements.end());
+    merged.kinds.push_back(NodeKind::PROGRAM);
+    merged.nodes.push_back(FlatNode{0, start, static_cast<uint32_t>(statements.size())});
+    // The parts' offsets are disjoint, so the merged root spans them all
+    SourceSpan first = parts.empty() ? SourceSpan{0, 0} : parts.front()->spans[parts.front()->root];
+    SourceSpan last = parts.empty() ? SourceSpan{0, 0} : parts.back()->spans[parts.back()->root];
+    merged.spans.push_back(SourceSpan{first.start, last.start + last.length - first.start});
+    merged.root = static_cast<NodeIndex>(merged.size() - 1);
+    return merged;
+}
+
+// Writes the text and JSON forms of a FlatAST. Output is gathered in a
+// fixed buffer and handed to the stream in large writes: an ostream
+// insertion per token costs more than formatting the token.
+class FlatPrinter {
+private:
+    const FlatAST& flat;
+    std::ostream& out;
+    char buffer[64 * 1024];
+    size_t used;
+
+    void flush() {
+        out.write(buffer, static_cast<std::streamsize>(used));
+        used = 0;
+    }
+
+    char* reserve(size_t size) {
+        if (used + size > sizeof(buffer)) {
+            flush();
+        }
+        return buffer + used;
+    }
+
+    void put(char c) {
+        *reserve(1) = c;
+        used++;
+    }
+
+    void put(std::string_view text) {
+        if (text.size() > sizeof(buffer) / 2) {
+            flush();
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            return;
+        }
+        std::memcpy(reserve(text.size()), text.data(), text.size());
+        used += text.size();
+    }
+
+    void putInteger(int64_t value) {
+        char* first = reserve(24);
+        used = static_cast<size_t>(std::to_chars(first, buffer + sizeof(buffer), value).ptr - buffer);
+    }
+
+    // Fixed with six decimals is printf's %f, so this matches writeNumber
+    void putFixed(double value) {
+        char* first = reserve(330);
+        used = static_cast<size_t>(
+            std::to_chars(first, buffer + sizeof(buffer), value, std::chars_format::fixed, 6).ptr - buffer);
+    }
+
+    // The shortest text that reads back as the same double
+    void putShortest(double value) {
+        char* first = reserve(32);
+        used = static_cast<size_t>(std::to_chars(first, buffer + sizeof(buffer), value).ptr - buffer);
+    }
+
+    // A JSON string literal: quotes, backslashes and control characters are
+    // escaped, other bytes (UTF-8 included) pass through
+    void putJsonString(std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+        put('"');
+        size_t run = 0;  // start of the bytes not yet written
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            put(text.substr(run, i - run));
+            run = i + 1;
+            switch (c) {
+                case '"': put("\\\""); break;
+                case '\\': put("\\\\"); break;
+                case '\n': put("\\n"); break;
+                case '\r': put("\\r"); break;
+                case '\t': put("\\t"); break;
+                default:
+                    put("\\u00");
+                    put(hex[c >> 4]);
+                    put(hex[c & 15]);
+                    break;
+            }
+        }
+        put(text.substr(run));
+        put('"');
+    }
+
+    // Expanding a node prints it, handing each child and each piece of text
+    // after the first child to `later`. While the tree is shallow, `later`
+    // prints at once and children recurse; past RECURSION_LIMIT the pieces
+    // are queued on `pending` instead, so any depth prints in bounded
+    // native stack.
+    struct Pending {
+        NodeIndex node;
+        std::string_view text;  // null for a node still to expand
+    };
+
+    // A JSON call costs four frames a level (later, expand, expandJson,
+    // laterJsonList), so this is the parser's limit, not FlatBuilder's
+    static constexpr size_t RECURSION_LIMIT = 1024;
+
+    std::vector<Pending> pending;
+    bool asJson;  // which form expand writes
+    size_t depth;
+    bool queueing;
+
+    void later(NodeIndex index) {
+        if (queueing) {
+            pending.push_back(Pending{index, std::string_view()});
+        } else if (depth == RECURSION_LIMIT) {
+            printIteratively(index);
+        } else {
+            depth++;
+            expand(index);
+            depth--;
+        }
+    }
+
+    void later(std::string_view text) {
+        if (queueing) {
+            pending.push_back(Pending{NO_NODE, text});
+        } else {
+            put(text);
+        }
+    }
+
+    void laterJsonList(uint32_t start, uint32_t count) {
+        later("[");
+        for (uint32_t i = 0; i < count; ++i) {
+            if (i > 0) later(",");
+            later(flat.lists[start + i]);
+        }
+        later("]");
+    }
+
+    // Each expansion queues its pieces in output order; they are reversed
+    // onto the stack so the first comes off first
+    void printIteratively(NodeIndex root) {
+        queueing = true;
+        pending.push_back(Pending{root, std::string_view()});
+        while (!pending.empty()) {
+            Pending next = pending.back();
+            pending.pop_back();
+            if (next.text.data()) {
+                put(next.text);
+                continue;
+            }
+            size_t mark = pending.size();
+            expand(next.node);
+            std::reverse(pending.begin() + static_cast<std::ptrdiff_t>(mark), pending.end());
+        }
+        queueing = false;
+    }
+
+    void expand(NodeIndex index) {
+        if (asJson) {
+            expandJson(index);
+        } else {
+            expandText(index);
+        }
+    }
+
+    // The operator with a space either side, as one piece
+    static std::string_view spacedOperator(BinaryOperator op) {
+        switch (op) {
+            case BinaryOperator::ADD: return " + ";
+            case BinaryOperator::SUBTRACT: return " - ";
+            case BinaryOperator::MULTIPLY: return " * ";
+            case BinaryOperator::DIVIDE: return " / ";
+        }
+        return " ? ";
+    }
+
+    void expandText(NodeIndex index) {
+        if (index == NO_NODE) {
+            return;
+        }
+        const FlatNode& n = flat.nodes[index];
+        switch (flat.kinds[index]) {
+            case NodeKind::NUMBER:
+                putFixed(flat.number(index));
+                break;
+            case NodeKind::INTEGER:
+                putInteger(flat.integer(index));
+                break;
+            case NodeKind::STRING:
+                put('"');
+                put(flat.strings[n.a]);
+                put('"');
+                break;
+            case NodeKind::IDENTIFIER:
+                put(symbols().name(n.a));
+                break;
+            case NodeKind::BINARY:
+                put('(');
+                later(n.a);
+                later(spacedOperator(static_cast<BinaryOperator>(n.c)));
+                later(n.b);
+                later(")");
+                break;
+            case NodeKind::CALL:
+                later(n.a);
+                later("(");
+                for (uint32_t i = 0; i < n.c; ++i) {
+                    if (i > 0) later(", ");
+                    later(flat.lists[n.b + i]);
+                }
+                later(")");
+                break;
+            case NodeKind::EXPRESSION_STATEMENT:
+                later(n.a);
+                later(";");
+                break;
+            case NodeKind::LET:
+                put("let ");
+                put(symbols().name(n.a));
+                put(" = ");
+                later(n.b);
+                later(";");
+                break;
+            case NodeKind::BLOCK:
+                put("{\n");
+                for (uint32_t i = 0; i < n.c; ++i) {
+                    later("  ");
+                    later(flat.lists[n.b + i]);
+                    later("\n");
+                }
+                later("}");
+                break;
+            case NodeKind::FUNCTION:
+                put("function ");
+                put(symbols().name(n.a));
+                put('(');
+                for (uint32_t i = 0; i < n.c; ++i) {
+                    if (i > 0) put(", ");
+                    put(symbols().name(flat.lists[n.b + 1 + i]));
+                }
+                put(") ");
+                later(flat.lists[n.b]);
+                break;
+            case NodeKind::ONCLICK:
+                put("onClick(\"");
+                put(symbols().name(n.a));
+                put("\") ");
+                later(n.b);
+                break;
+            case NodeKind::RETURN:
+                put("return");
+                if (n.a != NO_NODE) {
+                    put(' ');
+                    later(n.a);
+                }
+                later(";");
+                break;
+            case NodeKind::IF:
+                put("if (");
+                later(n.a);
+                later(") ");
+                later(n.b);
+                if (n.c != NO_NODE) {
+                    later(" else ");
+                    later(n.c);
+                }
+                break;
+            case NodeKind::PROGRAM:
+                for (uint32_t i = 0; i < n.c; ++i) {
+                    later(flat.lists[n.b + i]);
+                    later("\n");
+                }
+                break;
+        }
+    }
+
+    void expandJson(NodeIndex index) {
+        if (index == NO_NODE) {
+            put("null");
+            return;
+        }
+        const FlatNode& n = flat.nodes[index];
+        switch (flat.kinds[index]) {
+            case NodeKind::NUMBER: {
+                // JSON has no infinities or NaN; folding can produce them
+                double value = flat.number(index);
+                put("{\"type\":\"Number\",\"value\":");
+                if (std::isfinite(value)) {
+                    putShortest(value);
+                } else {
+                    put("null");
+                }
+                put('}');
+                break;
+            }
+            case NodeKind::INTEGER:
+                put("{\"type\":\"Integer\",\"value\":");
+                putInteger(flat.integer(index));
+                put('}');
+                break;
+            case NodeKind::STRING:
+                put("{\"type\":\"String\",\"value\":");
+                putJsonString(flat.strings[n.a]);
+                put('}');
+                break;
+            case NodeKind::IDENTIFIER:
+                put("{\"type\":\"Identifier\",\"name\":");
+                putJsonString(symbols().name(n.a));
+                put('}');
+                break;
+            case NodeKind::BINARY:
+                put("{\"type\":\"Binary\",\"operator\":\"");
+                put(binaryOperatorText(static_cast<BinaryOperator>(n.c)));
+                put("\",\"left\":");
+                later(n.a);
+                later(",\"right\":");
+                later(n.b);
+                later("}");
+                break;
+            case NodeKind::CALL:
+                put("{\"type\":\"Call\",\"callee\":");
+                later(n.a);
+                later(",\"arguments\":");
+                laterJsonList(n.b, n.c);
+                later("}");
+                break;
+            case NodeKind::EXPRESSION_STATEMENT:
+                put("{\"type\":\"ExpressionStatement\",\"expression\":");
+                later(n.a);
+                later("}");
+                break;
+            case NodeKind::LET:
+                put("{\"type\":\"Let\",\"name\":");
+                putJsonString(symbols().name(n.a));
+                put(",\"value\":");
+                later(n.b);
+                later("}");
+                break;
+            case NodeKind::BLOCK:
+                put("{\"type\":\"Block\",\"body\":");
+                laterJsonList(n.b, n.c);
+                later("}");
+                break;
+            case NodeKind::FUNCTION:
+                put("{\"type\":\"Function\",\"name\":");
+                putJsonString(symbols().name(n.a));
+                put(",\"parameters\":[");
+                for (uint32_t i = 0; i < n.c; ++i) {
+                    if (i > 0) put(',');
+                    putJsonString(symbols().name(flat.lists[n.b + 1 + i]));
+                }
+                put("],\"body\":");
+                later(flat.lists[n.b]);
+                later("}");
+                break;
+            case NodeKind::ONCLICK:
+                put("{\"type\":\"OnClick\",\"element\":");
+                putJsonString(symbols().name(n.a));
+                put(",\"body\":");
+                later(n.b);
+                later("}");
+                break;
+            case NodeKind::RETURN:
+                put("{\"type\":\"Return\",\"value\":");
+                later(n.a);
+                later("}");
+                break;
+            case NodeKind::IF:
+                put("{\"type\":\"If\",\"condition\":");
+                later(n.a);
+                later(",\"consequence\":");
+                later(n.b);
+                later(",\"alternative\":");
+                later(n.c);
+                later("}");
+                break;
+            case NodeKind::PROGRAM:
+                // One statement per line, so large dumps can be split and
+                // diffed with line tools
+                put("{\"type\":\"Program\",\"body\":[");
+                for (uint32_t i = 0; i < n.c; ++i) {
+                    later(i > 0 ? ",\n" : "\n");
+                    later(flat.lists[n.b + i]);
+                }
+                later("\n]}");
+                break;
+        }
+    }
+
+public:
+    FlatPrinter(const FlatAST& flat, std::ostream& out)
+        : flat(flat), out(out), used(0), asJson(false), depth(0), queueing(false) {}
+    ~FlatPrinter() { flush(); }
+
+    FlatPrinter(const FlatPrinter&) = delete;
+    FlatPrinter& operator=(const FlatPrinter&) = delete;
+
+    void text(NodeIndex index) {
+        asJson = false;
+        later(index);
+    }
+
+    void json(NodeIndex index) {
+        asJson = true;
+        later(index);
+    }
+};
+
+void FlatAST::print(std::ostream& out, NodeIndex index) const {
+    FlatPrinter(*this, out).text(index);
+}
+
+void FlatAST::printJson(std::ostream& out, NodeIndex index) const {
+    FlatPrinter(*this, out).json(index);
+}
+
+std::string FlatAST::toString(NodeIndex index) const {
+    std::ostringstream out;
+    print(out, index);
+    return out.str();
+}
+
+size_t FlatAST::memoryUsage() const {
+    return kinds.capacity() * sizeof(NodeKind) + nodes.capacity() * sizeof(FlatNode) +
+           spans.capacity() * sizeof(SourceSpan) + lists.capacity() * sizeof(uint32_t) + strings.capacity() * sizeof(std::string_view);
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "source.h"
+#include "symbol.h"
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Program;
+
+enum class NodeKind : uint8_t {
+    NUMBER,
+    INTEGER,
+    STRING,
+    IDENTIFIER,
+    BINARY,
+    CALL,
+    EXPRESSION_STATEMENT,
+    LET,
+    BLOCK,
+    FUNCTION,
+    ONCLICK,
+    RETURN,
+    IF,
+    PROGRAM
+};
+
+using NodeIndex = uint32_t;
+
+constexpr NodeIndex NO_NODE = UINT32_MAX;
+
+/**
+ * Three 32-bit operands whose meaning depends on the node's kind:
+ *
+ *   NUMBER, INTEGER           the 64-bit value, low half in a, high in b
+ *   STRING                    a = index into strings
+ *   IDENTIFIER                a = Symbol
+ *   BINARY                    a = left, b = right, c = BinaryOperator
+ *   CALL                      a = callee, lists[b .. b+c) = arguments
+ *   EXPRESSION_STATEMENT      a = expression
+ *   LET                       a = Symbol, b = value
+ *   BLOCK, PROGRAM            lists[b .. b+c) = statements
+ *   FUNCTION                  a = Symbol, lists[b] = body,
+ *                             lists[b+1 .. b+1+c) = parameter Symbols
+ *   ONCLICK                   a = element id Symbol, b = body
+ *   RETURN                    a = value, NO_NODE for a bare return
+ *   IF                        a = condition, b = consequence block,
+ *                             c = alternative (a block or an IF), or
+ *                             NO_NODE without an else
+ */
+struct FlatNode {
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+/**
+ * FlatAST is a linearized copy of a Program: nodes live in one contiguous
+ * pool in post-order, so every subtree (an onClick body, say) occupies a
+ * contiguous index range ending at its root. Node kinds are kept apart in
+ * a packed one-byte tag array and children are 32-bit indices, so walking
+ * a subtree reads two dense arrays instead of chasing heap pointers.
+ * Missing children (left by parse errors) are NO_NODE. Source spans sit in
+ * a third array, read only when something needs reporting.
+ */
+class FlatAST {
+public:
+    std::vector<NodeKind> kinds;
+    std::vector<FlatNode> nodes;
+    std::vector<SourceSpan> spans;
+    std::vector<uint32_t> lists;  // child indices and parameter Symbols
+    std::vector<std::string_view> strings;  // views into the Program's arena
+    NodeIndex root = NO_NODE;
+
+    static FlatAST build(const Program& program);
+    // One program running each part's statements in turn: the parts'
+    // nodes copied end to end, with indices shifted, under a new root.
+    // String views still point into the parts' arenas.
+    static FlatAST concatenate(const std::vector<const FlatAST*>& parts);
+
+    size_t size() const { return kinds.size(); }
+    bool empty() const { return kinds.empty(); }
+    NodeKind kind(NodeIndex index) const { return kinds[index]; }
+    const FlatNode& node(NodeIndex index) const { return nodes[index]; }
+    SourceSpan span(NodeIndex index) const { return spans[index]; }
+    int64_t integer(NodeIndex index) const {
+        return static_cast<int64_t>(static_cast<uint64_t>(nodes[index].b) << 32 | nodes[index].a);
+    }
+    double number(NodeIndex index) const {
+        int64_t bits = integer(index);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    // Same text as ASTNode::print on the tree it was built from, streamed
+    void print(std::ostream& out, NodeIndex index) const;
+    void print(std::ostream& out) const { print(out, root); }
+    std::string toString(NodeIndex index) const;
+    std::string toString() const { return toString(root); }
+
+    // One JSON object per node: {"type": "Binary", "operator": "+",
+    // "left": {...}, "right": {...}} and so on, with missing children as
+    // null. The Program's statements go one per line.
+    void printJson(std::ostream& out, NodeIndex index) const;
+    void printJson(std::ostream& out) const { printJson(out, root); }
+
+    size_t memoryUsage() const;
+};
@@ -1,188 +1,570 @@
 #include "interpreter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
-Interpreter::Interpreter() {
-    environment = std::make_shared<Environment>();
+// Values the VM's stack starts with room for: a few thousand frames of an
+// ordinary function before it first has to grow
+static constexpr size_t INITIAL_STACK = 1 << 14;
+
+Interpreter::Interpreter()
+    : sources(nullptr), stack(INITIAL_STACK) {
+    calls.reserve(256);
     registerBuiltins();
 }
 
 void Interpreter::registerBuiltins() {
-    // Built-in functions are handled in CallExpression visitor
+    // Built-in functions are handled when evaluating a CallExpression
+}
+
+void Interpreter::interpret(const FlatAST& ast) {
+    run(compile(ast));
+}
+
+std::string Interpreter::locate(SourceSpan span) const {
+    std::string location = sources ? sources->describe(span.start) : "";
+    return location.empty() ? "" : location + ": ";
 }
 
-void Interpreter::interpret(Program& program) {
-    program.accept(*this);
+void Interpreter::runtimeError(SourceSpan span, const std::string& message) {
+    std::cerr << "Runtime error: " << locate(span) << message << std::endl;
 }
 
+static std::string argumentCountMessage(Symbol function, size_t parameters, size_t arguments) {
+    return std::string(symbols().name(function)) + " takes " + std::to_string(parameters) + " argument" +
+           (parameters == 1 ? "" : "s") + ", got " + std::to_string(arguments);
+}
+
+static std::string stackOverflowMessage(size_t depth) {
+    return "Stack overflow: calls nested more than " + std::to_string(depth) + " deep";
+}
+
+// No flush per line: std::cerr is tied to std::cout, so runtime errors
+// still come out in order with what was printed before them
 void Interpreter::print(const Value& value) {
-    std::cout << valueToString(value) << std::endl;
+    std::string buffer;
+    std::cout << valueText(value, buffer) << '\n';
 }
 
-void Interpreter::registerEventHandler(const std::string& elementId, std::function<void()> handler) {
+void Interpreter::registerEventHandler(Symbol elementId, std::function<void()> handler) {
     eventHandlers[elementId] = handler;
 }
 
 void Interpreter::triggerEvent(const std::string& elementId) {
-    auto it = eventHandlers.find(elementId);
+    auto it = eventHandlers.find(symbols().find(elementId));
     if (it != eventHandlers.end()) {
         it->second();
     }
 }
 
 std::string Interpreter::valueToString(const Value& value) {
-    return std::visit([](const auto& v) -> std::string {
-        using T = std::decay_t<decltype(v)>;
-        if constexpr (std::is_same_v<T, std::string>) {
-            return v;
-        } else if constexpr (std::is_same_v<T, double>) {
-            // Remove trailing zeros for cleaner output
-            std::string str = std::to_string(v);
-            str.erase(str.find_last_not_of('0') + 1, std::string::npos);
-            str.erase(str.find_last_not_of('.') + 1, std::string::npos);
-            return str;
-        } else if constexpr (std::is_same_v<T, bool>) {
-            return v ? "true" : "false";
-        }
-        return "";
-    }, value);
+    if (value.isString()) {
+        return std::string(value.asString().view());
+    } else if (value.isDouble()) {
+        // Remove trailing zeros for cleaner output
+        std::string str = std::to_string(value.asDouble());
+        str.erase(str.find_last_not_of('0') + 1, std::string::npos);
+        str.erase(str.find_last_not_of('.') + 1, std::string::npos);
+        return str;
+    } else if (value.isBoolean()) {
+        return value.asBoolean() ? "true" : "false";
+    }
+    return std::to_string(value.asInteger());
 }
 
-double Interpreter::valueToNumber(const Value& value) {
-    return std::visit([](const auto& v) -> double {
-        using T = std::decay_t<decltype(v)>;
-        if constexpr (std::is_same_v<T, double>) {
-            return v;
-        } else if constexpr (std::is_same_v<T, std::string>) {
-            try {
-                return std::stod(v);
-            } catch (...) {
-                return 0.0;
-            }
-        } else if constexpr (std::is_same_v<T, bool>) {
-            return v ? 1.0 : 0.0;
-        }
-        return 0.0;
-    }, value);
+// A string's own text, or the text of anything else formatted into `buffer`
+std::string_view Interpreter::valueText(const Value& value, std::string& buffer) {
+    if (value.isString()) {
+        return value.asString().view();
+    }
+    buffer = valueToString(value);
+    return buffer;
 }
 
-bool Interpreter::valueToBoolean(const Value& value) {
-    return std::visit([](const auto& v) -> bool {
-        using T = std::decay_t<decltype(v)>;
-        if constexpr (std::is_same_v<T, bool>) {
-            return v;
-        } else if constexpr (std::is_same_v<T, double>) {
-            return v != 0.0;
-        } else if constexpr (std::is_same_v<T, std::string>) {
-            return !v.empty();
-        }
-        return false;
-    }, value);
+double Interpreter::valueToNumber(const Value& value) {
+    if (value.isDouble()) {
+        return value.asDouble();
+    } else if (value.isString()) {
+        // What std::stod accepts, without copying the text into a std::string
+        const char* text = value.asString().chars;
+        char* end;
+        errno = 0;
+        double number = std::strtod(text, &end);
+        return end == text || errno == ERANGE ? 0.0 : number;
+    } else if (value.isBoolean()) {
+        return value.asBoolean() ? 1.0 : 0.0;
+    }
+    return static_cast<double>(value.asInteger());
 }
 
-void Interpreter::visit(NumberLiteral& node) {
-    lastValue = node.value;
+bool Interpreter::valueToBoolean(const Value& value) {
+    if (value.isBoolean()) {
+        return value.asBoolean();
+    } else if (value.isDouble()) {
+        return value.asDouble() != 0.0;
+    } else if (value.isString()) {
+        return value.asString().length != 0;
+    }
+    return value.asInteger() != 0;
 }
 
-void Interpreter::visit(StringLiteral& node) {
-    lastValue = node.value;
+bool Interpreter::binaryOperation(BinaryOperator op, const Value& leftVal, const Value& rightVal, Value& result) {
+    // Integer fast path; falls through to double arithmetic on overflow
+    // and for divisions that are not exact
+    if (leftVal.isInteger() && rightVal.isInteger()) {
+        int64_t a = leftVal.asInteger();
+        int64_t b = rightVal.asInteger();
+        int64_t exact;
+        switch (op) {
+            case BinaryOperator::ADD:
+                if (!__builtin_add_overflow(a, b, &exact)) {
+                    result = exact;
+                    return true;
+                }
+                break;
+            case BinaryOperator::SUBTRACT:
+                if (!__builtin_sub_overflow(a, b, &exact)) {
+                    result = exact;
+                    return true;
+                }
+                break;
+            case BinaryOperator::MULTIPLY:
+                if (!__builtin_mul_overflow(a, b, &exact)) {
+                    result = exact;
+                    return true;
+                }
+                break;
+            case BinaryOperator::DIVIDE:
+                if (b != 0 && !(a == INT64_MIN && b == -1) && a % b == 0) {
+                    result = a / b;
+                    return true;
+                }
+                break;
+        }
+    }
+    
+    switch (op) {
+        case BinaryOperator::ADD:
+            // Handle string concatenation
+            if (leftVal.isString() || rightVal.isString()) {
+                std::string leftBuffer, rightBuffer;
+                result = Value::concatenate(valueText(leftVal, leftBuffer), valueText(rightVal, rightBuffer));
+            } else {
+                result = valueToNumber(leftVal) + valueToNumber(rightVal);
+            }
+            break;
+        case BinaryOperator::SUBTRACT:
+            result = valueToNumber(leftVal) - valueToNumber(rightVal);
+            break;
+        case BinaryOperator::MULTIPLY:
+            result = valueToNumber(leftVal) * valueToNumber(rightVal);
+            break;
+        case BinaryOperator::DIVIDE: {
+            double rightNum = valueToNumber(rightVal);
+            if (rightNum == 0.0) {
+                return false;
+            }
+            result = valueToNumber(leftVal) / rightNum;
+            break;
+        }
+    }
+    return true;
 }
 
-void Interpreter::visit(Identifier& node) {
-    try {
-        lastValue = environment->get(node.name);
-    } catch (const std::runtime_error& e) {
-        std::cerr << "Runtime error: " << e.what() << std::endl;
-        lastValue = 0.0;
+void Interpreter::reserveStack(size_t size) {
+    if (size > stack.size()) {
+        stack.resize(std::max(size, stack.size() * 2));
     }
 }
 
-void Interpreter::visit(BinaryExpression& node) {
-    node.left->accept(*this);
-    Value leftVal = lastValue;
-    
-    node.right->accept(*this);
-    Value rightVal = lastValue;
-    
-    if (node.operator_ == "+") {
-        // Handle string concatenation
-        if (std::holds_alternative<std::string>(leftVal) || std::holds_alternative<std::string>(rightVal)) {
-            lastValue = valueToString(leftVal) + valueToString(rightVal);
-        } else {
-            lastValue = valueToNumber(leftVal) + valueToNumber(rightVal);
-        }
-    } else if (node.operator_ == "-") {
-        lastValue = valueToNumber(leftVal) - valueToNumber(rightVal);
-    } else if (node.operator_ == "*") {
-        lastValue = valueToNumber(leftVal) * valueToNumber(rightVal);
-    } else if (node.operator_ == "/") {
-        double rightNum = valueToNumber(rightVal);
-        if (rightNum == 0.0) {
-            std::cerr << "Runtime error: Division by zero" << std::endl;
-            lastValue = 0.0;
-        } else {
-            lastValue = valueToNumber(leftVal) / rightNum;
+Value* Interpreter::fitArguments(Value* sp, uint32_t count, uint32_t slot, const Chunk& chunk, uint32_t call) {
+    const Function& callee = functions[slot];
+    if (count != callee.arity) {
+        runtimeError(chunk.spanAt(call), argumentCountMessage(globalScope.functionNames[slot], callee.arity, count));
+        for (; count < callee.arity; count++) {
+            *sp++ = 0.0;
         }
+        sp -= count - callee.arity;
     }
+    return sp;
 }
 
-void Interpreter::visit(CallExpression& node) {
-    // Check if it's a built-in function
-    if (auto ident = dynamic_cast<Identifier*>(node.function.get())) {
-        if (ident->name == "print") {
-            if (!node.arguments.empty()) {
-                node.arguments[0]->accept(*this);
-                print(lastValue);
-            }
-            lastValue = 0.0; // print returns nothing
-            return;
-        }
+Chunk& Interpreter::compile(const FlatAST& ast) {
+    chunks.push_back(std::make_unique<Chunk>(compileBytecode(ast, globalScope)));
+    Chunk& chunk = *chunks.back();
+    for (const auto& [span, name] : chunk.undefined) {
+        std::cerr << "Error: " << locate(span) << "Undefined variable: " << symbols().name(name) << std::endl;
     }
-    
-    // For now, we don't support user-defined functions
-    std::cerr << "Runtime error: Function calls not yet supported" << std::endl;
-    lastValue = 0.0;
+    globals.resize(globalScope.count);
+    functions.resize(globalScope.functionNames.size());
+    for (const CompiledFunction& function : chunk.functions) {
+        functions[function.slot] = {&chunk, function.entry, function.arity, function.frameSize};
+    }
+    return chunk;
 }
 
-void Interpreter::visit(ExpressionStatement& node) {
-    node.expression->accept(*this);
+static inline bool isNumber(const Value& value) {
+    return value.isDouble() || value.isInlineInteger();
 }
 
-void Interpreter::visit(LetStatement& node) {
-    node.value->accept(*this);
-    environment->define(node.name, lastValue);
+// A double, or an inline integer as binaryOperation would convert it
+static inline double toNumber(const Value& value) {
+    return value.isDouble() ? value.asDouble() : static_cast<double>(value.asInlineInteger());
 }
 
-void Interpreter::visit(BlockStatement& node) {
-    // Create new scope
-    auto previousEnv = environment;
-    environment = std::make_shared<Environment>(environment);
-    
-    for (auto& stmt : node.statements) {
-        stmt->accept(*this);
+// + - * on two inline integers, or on doubles mixed with them, without
+// leaving the dispatch loop. Anything else, integer overflow included, goes
+// through binaryOperation.
+template <BinaryOperator OP>
+static inline bool fastArithmetic(Value& left, const Value& right) {
+    if (left.isInlineInteger() && right.isInlineInteger()) {
+        // 48-bit operands: only a product can overflow 64 bits
+        int64_t a = left.asInlineInteger();
+        int64_t b = right.asInlineInteger();
+        int64_t result;
+        if (OP == BinaryOperator::MULTIPLY) {
+            if (__builtin_mul_overflow(a, b, &result)) {
+                return false;
+            }
+        } else {
+            result = OP == BinaryOperator::ADD ? a + b : a - b;
+        }
+        left = Value(result);
+        return true;
     }
-    
-    // Restore previous scope
-    environment = previousEnv;
+    if (!isNumber(left) || !isNumber(right)) {
+        return false;
+    }
+    double a = toNumber(left);
+    double b = toNumber(right);
+    left = Value(OP == BinaryOperator::ADD ? a + b : OP == BinaryOperator::SUBTRACT ? a - b : a * b);
+    return true;
 }
 
-void Interpreter::visit(FunctionDeclaration& node) {
-    // For now, we'll just store function declarations
-    // Full function support would require more complex implementation
-    std::cout << "Function '" << node.name << "' declared (not yet executable)" << std::endl;
+// The form an unspecialized ADD, SUBTRACT or MULTIPLY takes for the
+// operands it first runs with
+static OpCode specialize(OpCode op, const Value& left, const Value& right) {
+    bool integers = left.isInlineInteger() && right.isInlineInteger();
+    bool numbers = isNumber(left) && isNumber(right);
+    switch (op) {
+        case OpCode::ADD:
+            if (integers) return OpCode::ADD_INT;
+            if (numbers) return OpCode::ADD_NUMBER;
+            if (left.isString() && right.isString()) return OpCode::ADD_STRING;
+            if (left.isString() || right.isString()) return OpCode::ADD_CONCAT;
+            return OpCode::ADD_GENERIC;
+        case OpCode::SUBTRACT:
+            return integers ? OpCode::SUBTRACT_INT : numbers ? OpCode::SUBTRACT_NUMBER : OpCode::SUBTRACT_GENERIC;
+        default:
+            return integers ? OpCode::MULTIPLY_INT : numbers ? OpCode::MULTIPLY_NUMBER : OpCode::MULTIPLY_GENERIC;
+    }
 }
 
-void Interpreter::visit(OnClickStatement& node) {
-    // Register the event handler
-    registerEventHandler(node.elementId, [this, &node]() {
-        node.body->accept(*this);
-    });
+// GCC and Clang can jump straight from one instruction's handler to the
+// next through a table of label addresses, giving each handler its own
+// indirect branch to predict. Other compilers get a switch in a loop.
+#if defined(__GNUC__)
+#define KAROU_COMPUTED_GOTO 1
+#endif
+
+#ifdef KAROU_COMPUTED_GOTO
+#define VM_CASE(name) op_##name
+#define VM_DISPATCH() goto *DISPATCH_TABLE[*ip++]
+#else
+#define VM_CASE(name) case OpCode::name
+#define VM_DISPATCH() goto dispatch
+#endif
+
+// Rewrite the instruction being run to `op` and run it again as that. Its
+// operands are still on the stack.
+#define VM_REWRITE(op)                        \
+    do {                                      \
+        ip[-1] = static_cast<uint8_t>(op);    \
+        ip--;                                 \
+        VM_DISPATCH();                        \
+    } while (0)
+
+void Interpreter::run(Chunk& chunk, uint32_t entry) {
+    if (stack.size() < chunk.maxLocals + chunk.maxStack) {
+        stack.resize(chunk.maxLocals + chunk.maxStack);
+    }
+    Chunk* current = &chunk;  // the chunk holding the code being run
+    uint8_t* code = chunk.code.data();
+    uint8_t* ip = code + entry;
+    Value* frame = stack.data();
+    Value* global = globals.data();
+    Value* sp = frame + chunk.maxLocals;  // one past the top value
     
-    std::cout << "Event handler registered for element: " << node.elementId << std::endl;
-}
+    auto operand = [&ip]() {
+        uint32_t value;
+        std::memcpy(&value, ip, sizeof(value));
+        ip += sizeof(value);
+        return value;
+    };
+    auto literal = [&ip](auto value) {
+        std::memcpy(&value, ip, sizeof(value));
+        ip += sizeof(value);
+        return value;
+    };
+    // Offset of the instruction being run, whose opcode ip has moved past
+    auto offset = [&ip, &code]() { return static_cast<uint32_t>(ip - 1 - code); };
+    
+#ifdef KAROU_COMPUTED_GOTO
+    // In OpCode order
+    static const void* const DISPATCH_TABLE[] = {
+        &&op_INTEGER, &&op_NUMBER, &&op_CONSTANT, &&op_ZERO, &&op_GET_LOCAL, &&op_GET_GLOBAL, &&op_ADD,
+        &&op_SUBTRACT, &&op_MULTIPLY, &&op_DIVIDE, &&op_PRINT, &&op_POP, &&op_SET_LOCAL, &&op_SET_GLOBAL,
+        &&op_ON_CLICK, &&op_JUMP, &&op_JUMP_IF_FALSE, &&op_CALL, &&op_TAIL_CALL, &&op_RETURN_VALUE,
+        &&op_RETURN, &&op_ADD_INT, &&op_ADD_NUMBER, &&op_ADD_STRING, &&op_ADD_CONCAT, &&op_ADD_GENERIC, &&op_SUBTRACT_INT, &&op_SUBTRACT_NUMBER,
+        &&op_SUBTRACT_GENERIC, &&op_MULTIPLY_INT, &&op_MULTIPLY_NUMBER, &&op_MULTIPLY_GENERIC,
+    };
+    static_assert(sizeof(DISPATCH_TABLE) / sizeof(DISPATCH_TABLE[0]) ==
+                      static_cast<size_t>(OpCode::MULTIPLY_GENERIC) + 1,
+                  "one label per opcode");
+    VM_DISPATCH();
+#else
+dispatch:
+    switch (static_cast<OpCode>(*ip++)) {
+#endif
+    VM_CASE(INTEGER):
+        *sp++ = literal(int64_t());
+        VM_DISPATCH();
+    VM_CASE(NUMBER):
+        *sp++ = literal(double());
+        VM_DISPATCH();
+    VM_CASE(CONSTANT):
+        *sp++ = current->constants[operand()];
+        VM_DISPATCH();
+    VM_CASE(ZERO):
+        *sp++ = 0.0;
+        VM_DISPATCH();
+    VM_CASE(GET_LOCAL):
+        *sp++ = frame[operand()];
+        VM_DISPATCH();
+    VM_CASE(GET_GLOBAL):
+        *sp++ = global[operand()];
+        VM_DISPATCH();
+    VM_CASE(ADD):
+        VM_REWRITE(specialize(OpCode::ADD, sp[-2], sp[-1]));
+    VM_CASE(SUBTRACT):
+        VM_REWRITE(specialize(OpCode::SUBTRACT, sp[-2], sp[-1]));
+    VM_CASE(MULTIPLY):
+        VM_REWRITE(specialize(OpCode::MULTIPLY, sp[-2], sp[-1]));
+    VM_CASE(DIVIDE):
+        sp--;
+        if (!binaryOperation(BinaryOperator::DIVIDE, sp[-1], sp[0], sp[-1])) {
+            runtimeError(current->spanAt(offset()), "Division by zero");
+            sp[-1] = 0.0;
+        }
+        VM_DISPATCH();
+    VM_CASE(PRINT):
+        print(sp[-1]);
+        sp[-1] = 0.0; // print returns nothing
+        VM_DISPATCH();
+    VM_CASE(POP):
+        lastValue = std::move(*--sp);
+        VM_DISPATCH();
+    VM_CASE(SET_LOCAL):
+        frame[operand()] = std::move(*--sp);
+        VM_DISPATCH();
+    VM_CASE(SET_GLOBAL):
+        global[operand()] = std::move(*--sp);
+        VM_DISPATCH();
+    VM_CASE(ON_CLICK): {
+        Symbol elementId = operand();
+        uint32_t body = operand();
+        Chunk* owner = current;
+        registerEventHandler(elementId, [this, owner, body]() {
+            run(*owner, body);
+        });
+        std::cout << "Event handler registered for element: " << symbols().name(elementId) << '\n';
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP):
+        ip = code + operand();
+        VM_DISPATCH();
+    VM_CASE(JUMP_IF_FALSE): {
+        uint32_t target = operand();
+        if (!valueToBoolean(*--sp)) {
+            ip = code + target;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(CALL): {
+        uint32_t at = offset();
+        uint32_t slot = operand();
+        uint32_t count = operand();
+        const Function& callee = functions[slot];
+        if (!callee.chunk) {
+            runtimeError(current->spanAt(at), "Undefined function: " +
+                                                  std::string(symbols().name(globalScope.functionNames[slot])));
+            sp -= count;
+            *sp++ = 0.0;
+            VM_DISPATCH();
+        }
+        if (calls.size() == MAX_CALL_DEPTH) {
+            // Abandon every call running and resume after the outermost
+            // one, which returns 0 like any call that fails
+            runtimeError(current->spanAt(at), stackOverflowMessage(MAX_CALL_DEPTH));
+            Value* result = calls.size() > 1 ? stack.data() + calls[1].frame : frame;
+            *result = 0.0;
+            sp = result + 1;
+            const CallFrame& outermost = calls.front();
+            frame = stack.data() + outermost.frame;
+            current = outermost.chunk;
+            code = current->code.data();
+            ip = outermost.ip;
+            calls.clear();
+            VM_DISPATCH();
+        }
+        // The arguments become the callee's first frame slots where they are
+        size_t caller = frame - stack.data();
+        size_t base = sp - stack.data() - count;
+        reserveStack(base + std::max(callee.frameSize, count) + callee.chunk->maxStack);
+        sp = fitArguments(stack.data() + base + count, count, slot, *current, at);
+        calls.push_back({current, ip, caller});
+        frame = stack.data() + base;
+        sp = frame + callee.frameSize;
+        current = callee.chunk;
+        code = current->code.data();
+        ip = code + callee.entry;
+        VM_DISPATCH();
+    }
+    VM_CASE(TAIL_CALL): {
+        uint32_t at = offset();
+        uint32_t slot = operand();
+        uint32_t count = operand();
+        const Function& callee = functions[slot];
+        if (!callee.chunk) {
+            // Returns the 0 an undefined function gives
+            runtimeError(current->spanAt(at), "Undefined function: " +
+                                                  std::string(symbols().name(globalScope.functionNames[slot])));
+            sp -= count;
+            *sp++ = 0.0;
+            VM_DISPATCH();
+        }
+        // Move the arguments down over this call's frame and run the callee
+        // in it, so a chain of tail calls takes no more stack than one call
+        size_t base = frame - stack.data();
+        size_t top = sp - stack.data();
+        reserveStack(std::max(base + callee.frameSize + callee.chunk->maxStack, top + callee.arity));
+        frame = stack.data() + base;
+        sp = fitArguments(stack.data() + top, count, slot, *current, at);
+        Value* arguments = sp - callee.arity;
+        for (uint32_t i = 0; i < callee.arity; i++) {
+            frame[i] = std::move(arguments[i]);
+        }
+        sp = frame + callee.frameSize;
+        current = callee.chunk;
+        code = current->code.data();
+        ip = code + callee.entry;
+        VM_DISPATCH();
+    }
+    VM_CASE(RETURN_VALUE): {
+        // The result takes the place of the first argument in the caller
+        *frame = std::move(sp[-1]);
+        sp = frame + 1;
+        const CallFrame& caller = calls.back();
+        frame = stack.data() + caller.frame;
+        current = caller.chunk;
+        code = current->code.data();
+        ip = caller.ip;
+        calls.pop_back();
+        VM_DISPATCH();
+    }
+    VM_CASE(RETURN):
+        return;
 
-void Interpreter::visit(Program& node) {
-    for (auto& stmt : node.statements) {
-        stmt->accept(*this);
+    // Specialized arithmetic: a guard on the operand types, then the fast
+    // path, or a rewrite to the next wider form. 48-bit integers cannot
+    // overflow a sum or difference.
+    VM_CASE(ADD_INT):
+        if (!sp[-2].isInlineInteger() || !sp[-1].isInlineInteger()) {
+            VM_REWRITE(OpCode::ADD_NUMBER);
+        }
+        sp--;
+        sp[-1] = Value(sp[-1].asInlineInteger() + sp[0].asInlineInteger());
+        VM_DISPATCH();
+    VM_CASE(ADD_NUMBER):
+        if (!isNumber(sp[-2]) || !isNumber(sp[-1])) {
+            VM_REWRITE(OpCode::ADD_GENERIC);
+        }
+        sp--;
+        sp[-1] = Value(toNumber(sp[-1]) + toNumber(sp[0]));
+        VM_DISPATCH();
+    VM_CASE(ADD_STRING):
+        if (!sp[-2].isString() || !sp[-1].isString()) {
+            VM_REWRITE(OpCode::ADD_CONCAT);
+        }
+        sp--;
+        sp[-1] = Value::concatenate(sp[-1].asString().view(), sp[0].asString().view());
+        VM_DISPATCH();
+    VM_CASE(ADD_CONCAT):
+        if (!sp[-2].isString() && !sp[-1].isString()) {
+            VM_REWRITE(OpCode::ADD_GENERIC);
+        }
+        sp--;
+        // Formatting the other operand needs a std::string, which a
+        // computed goto out of this handler would never destroy
+        binaryOperation(BinaryOperator::ADD, sp[-1], sp[0], sp[-1]);
+        VM_DISPATCH();
+    VM_CASE(ADD_GENERIC):
+        sp--;
+        if (!fastArithmetic<BinaryOperator::ADD>(sp[-1], sp[0])) {
+            binaryOperation(BinaryOperator::ADD, sp[-1], sp[0], sp[-1]);
+        }
+        VM_DISPATCH();
+    VM_CASE(SUBTRACT_INT):
+        if (!sp[-2].isInlineInteger() || !sp[-1].isInlineInteger()) {
+            VM_REWRITE(OpCode::SUBTRACT_NUMBER);
+        }
+        sp--;
+        sp[-1] = Value(sp[-1].asInlineInteger() - sp[0].asInlineInteger());
+        VM_DISPATCH();
+    VM_CASE(SUBTRACT_NUMBER):
+        if (!isNumber(sp[-2]) || !isNumber(sp[-1])) {
+            VM_REWRITE(OpCode::SUBTRACT_GENERIC);
+        }
+        sp--;
+        sp[-1] = Value(toNumber(sp[-1]) - toNumber(sp[0]));
+        VM_DISPATCH();
+    VM_CASE(SUBTRACT_GENERIC):
+        sp--;
+        if (!fastArithmetic<BinaryOperator::SUBTRACT>(sp[-1], sp[0])) {
+            binaryOperation(BinaryOperator::SUBTRACT, sp[-1], sp[0], sp[-1]);
+        }
+        VM_DISPATCH();
+    VM_CASE(MULTIPLY_INT): {
+        if (!sp[-2].isInlineInteger() || !sp[-1].isInlineInteger()) {
+            VM_REWRITE(OpCode::MULTIPLY_NUMBER);
+        }
+        sp--;
+        int64_t product;
+        if (__builtin_mul_overflow(sp[-1].asInlineInteger(), sp[0].asInlineInteger(), &product)) {
+            // Becomes a double; the next run with a double operand widens
+            binaryOperation(BinaryOperator::MULTIPLY, sp[-1], sp[0], sp[-1]);
+        } else {
+            sp[-1] = Value(product);
+        }
+        VM_DISPATCH();
     }
-}
\ No newline at end of file
+    VM_CASE(MULTIPLY_NUMBER):
+        if (!isNumber(sp[-2]) || !isNumber(sp[-1])) {
+            VM_REWRITE(OpCode::MULTIPLY_GENERIC);
+        }
+        sp--;
+        sp[-1] = Value(toNumber(sp[-1]) * toNumber(sp[0]));
+        VM_DISPATCH();
+    VM_CASE(MULTIPLY_GENERIC):
+        sp--;
+        if (!fastArithmetic<BinaryOperator::MULTIPLY>(sp[-1], sp[0])) {
+            binaryOperation(BinaryOperator::MULTIPLY, sp[-1], sp[0], sp[-1]);
+        }
+        VM_DISPATCH();
+#ifndef KAROU_COMPUTED_GOTO
+    }
+#endif
+}
@@ -1,89 +1,108 @@
 #pragma once
 #include "ast.h"
+#include "bytecode.h"
+#include "source.h"
+#include "value.h"
+#include <cstdint>
 #include <unordered_map>
-#include <variant>
 #include <functional>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
-// Value types that our interpreter can handle
-using Value = std::variant<double, std::string, bool>;
-
-class Environment {
+class Interpreter {
 private:
-    std::unordered_map<std::string, Value> variables;
-    std::shared_ptr<Environment> parent;
-
-public:
-    Environment(std::shared_ptr<Environment> parent = nullptr) : parent(parent) {}
+    // A function as the VM calls it: the chunk holding its code, or
+    // nullptr while no chunk compiled so far declares it
+    struct Function {
+        Chunk* chunk = nullptr;
+        uint32_t entry = 0;
+        uint32_t arity = 0;
+        uint32_t frameSize = 0;
+    };
     
-    void define(const std::string& name, const Value& value) {
-        variables[name] = value;
-    }
+    // Where a call returns to. Frames are kept as offsets into `stack`,
+    // which may move when it grows.
+    struct CallFrame {
+        Chunk* chunk;
+        uint8_t* ip;
+        size_t frame;
+    };
     
-    Value get(const std::string& name) {
-        auto it = variables.find(name);
-        if (it != variables.end()) {
-            return it->second;
-        }
-        
-        if (parent) {
-            return parent->get(name);
-        }
-        
-        throw std::runtime_error("Undefined variable: " + name);
-    }
+    // A call nested deeper than this is a stack overflow, which abandons
+    // every call running: the outermost returns 0 and the run goes on.
+    // Tail calls reuse their caller's frame, so never count.
+    static constexpr size_t MAX_CALL_DEPTH = 100000;
     
-    void set(const std::string& name, const Value& value) {
-        auto it = variables.find(name);
-        if (it != variables.end()) {
-            it->second = value;
-            return;
-        }
-        
-        if (parent) {
-            parent->set(name, value);
-            return;
-        }
-        
-        throw std::runtime_error("Undefined variable: " + name);
-    }
-};
-
-class Interpreter : public ASTVisitor {
-private:
-    std::shared_ptr<Environment> environment;
     Value lastValue;
-    std::unordered_map<std::string, std::function<void()>> eventHandlers;
+    std::unordered_map<Symbol, std::function<void()>> eventHandlers;
+    SourceMap* sources;  // names the script behind a span in runtime errors
+    // Every chunk compiled so far. Registered handlers run code inside
+    // them, so they live as long as the interpreter.
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    GlobalScope globalScope;
+    std::vector<Value> globals;      // by GlobalScope slot
+    std::vector<Function> functions; // by GlobalScope function slot
+    // The VM's frames, each followed by its operand stack, with the next
+    // call's frame starting at its arguments. Allocated up front and grown
+    // by doubling, never per call.
+    std::vector<Value> stack;
+    std::vector<CallFrame> calls;    // the calls running, innermost last
 
 public:
     Interpreter();
     
-    void interpret(Program& program);
+    // Runtime errors say where they happened once the map holding the
+    // program's scripts is set; it must outlive the interpreter
+    void setSourceMap(SourceMap* map) { sources = map; }
+    
+    // Compile the program's flat AST to bytecode and run that
+    void interpret(const FlatAST& ast);
     Value getLastValue() const { return lastValue; }
     
+    // Compile without running, for a caller that wants to show the code
+    // first. Names no let binds are reported on stderr here, not when
+    // run. The chunk is kept for as long as the interpreter lives.
+    Chunk& compile(const FlatAST& ast);
+    // Run `chunk` from `entry` up to its RETURN, calling into other chunks
+    // as it goes. Arithmetic instructions specialize themselves as they
+    // run, so the code changes. Not reentrant: the code never triggers
+    // events, so one run never starts another.
+    void run(Chunk& chunk, uint32_t entry = 0);
+    
+    // The value of `left op right`, as the interpreter computes it. Returns
+    // false, leaving `result` untouched, on division by zero. `result` may
+    // be `left` itself.
+    static bool binaryOperation(BinaryOperator op, const Value& left, const Value& right, Value& result);
+    
     // Built-in functions
     void registerBuiltins();
     void print(const Value& value);
     
     // Event handling
-    void registerEventHandler(const std::string& elementId, std::function<void()> handler);
+    void registerEventHandler(Symbol elementId, std::function<void()> handler);
     void triggerEvent(const std::string& elementId);
     
-    // Visitor methods
-    void visit(NumberLiteral& node) override;
-    void visit(StringLiteral& node) override;
-    void visit(Identifier& node) override;
-    void visit(BinaryExpression& node) override;
-    void visit(CallExpression& node) override;
-    void visit(ExpressionStatement& node) override;
-    void visit(LetStatement& node) override;
-    void visit(BlockStatement& node) override;
-    void visit(FunctionDeclaration& node) override;
-    void visit(OnClickStatement& node) override;
-    void visit(Program& node) override;
-    
 private:
-    std::string valueToString(const Value& value);
-    double valueToNumber(const Value& value);
-    bool valueToBoolean(const Value& value);
+    // Grow the VM's stack to hold at least `size` values. Pointers into it
+    // are invalid afterwards.
+    void reserveStack(size_t size);
+    // Pad or drop the `count` arguments below `sp` to the parameters of the
+    // function in `slot`, reporting a mismatch against the instruction at
+    // `call` in `chunk`. Returns the new top; the stack must have room for
+    // the padding.
+    Value* fitArguments(Value* sp, uint32_t count, uint32_t slot, const Chunk& chunk, uint32_t call);
+    
+    // "Runtime error: file:line:column: message" on stderr, without the
+    // location when the span is in no known script
+    void runtimeError(SourceSpan span, const std::string& message);
+    // "file:line:column: " for a span in a known script, else empty
+    std::string locate(SourceSpan span) const;
+    
+    static std::string valueToString(const Value& value);
+    static std::string_view valueText(const Value& value, std::string& buffer);
+    static double valueToNumber(const Value& value);
+    static bool valueToBoolean(const Value& value);
 };
\ No newline at end of file
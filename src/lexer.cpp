@@ -1,9 +1,13 @@
 #include "lexer.h"
+#include "charscan.h"
 #include <cctype>
-#include <unordered_map>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 
-Lexer::Lexer(const std::string& input) 
-    : input(input), position(0), readPosition(0), line(1), column(1) {
+Lexer::Lexer(std::string_view input, size_t start) 
+    : input(input), position(0), readPosition(start), lastStringDecoded(false) {
     readChar();
 }
 
@@ -15,13 +19,21 @@ void Lexer::readChar() {
     }
     position = readPosition;
     readPosition++;
-    
-    if (ch == '\n') {
-        line++;
-        column = 1;
-    } else {
-        column++;
-    }
+}
+
+void Lexer::advanceTo(size_t target) {
+    // Same effect as calling readChar() until position == target
+    position = target;
+    readPosition = target + 1;
+    ch = target < input.length() ? input[target] : 0;
+}
+
+const char* Lexer::cursor() const {
+    return input.data() + (position < input.length() ? position : input.length());
+}
+
+size_t Lexer::remaining() const {
+    return position < input.length() ? input.length() - position : 0;
 }
 
 char Lexer::peekChar() {
@@ -32,36 +44,109 @@ char Lexer::peekChar() {
 }
 
 void Lexer::skipWhitespace() {
-    while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
-        readChar();
+    const CharScanner& scan = charScanner();
+    while (true) {
+        size_t n = scan.whitespaceLength(cursor(), remaining());
+        if (n > 0) {
+            advanceTo(position + n);
+        }
+        
+        // Line comments run to the end of the line
+        if (ch == '/' && peekChar() == '/') {
+            const void* newline = std::memchr(cursor(), '\n', remaining());
+            advanceTo(newline ? static_cast<size_t>(static_cast<const char*>(newline) - input.data()) : input.length());
+            continue;
+        }
+        
+        return;
     }
 }
 
-std::string Lexer::readNumber() {
+static inline bool isIdentifierChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+TokenType Lexer::readNumber(std::string_view& text, LiteralValue& value) {
+    const CharScanner& scan = charScanner();
     size_t startPos = position;
-    while (isdigit(ch) || ch == '.') {
+    bool isReal = false;
+    
+    advanceTo(position + scan.digitLength(cursor(), remaining()));
+    if (ch == '.') {
+        isReal = true;
         readChar();
+        advanceTo(position + scan.digitLength(cursor(), remaining()));
     }
-    return input.substr(startPos, position - startPos);
+    
+    // A second '.' or a letter glued on (1.2.3, 12abc) makes the whole run illegal
+    if (ch == '.' || isIdentifierChar(ch)) {
+        while (ch == '.' || isIdentifierChar(ch)) {
+            readChar();
+        }
+        text = input.substr(startPos, position - startPos);
+        return TokenType::ILLEGAL;
+    }
+    
+    text = input.substr(startPos, position - startPos);
+    const char* first = text.data();
+    const char* last = first + text.length();
+    
+    if (!isReal) {
+        if (std::from_chars(first, last, value.integer).ec == std::errc()) {
+            return TokenType::INTEGER;
+        }
+        // Too large for int64_t: keep it as a real
+    }
+    
+    if (std::from_chars(first, last, value.real).ec == std::errc::result_out_of_range) {
+        value.real = HUGE_VAL;
+    }
+    return TokenType::NUMBER;
 }
 
-std::string Lexer::readIdentifier() {
+std::string_view Lexer::readIdentifier() {
     size_t startPos = position;
-    while (isalnum(ch) || ch == '_') {
-        readChar();
-    }
+    advanceTo(position + charScanner().identifierLength(cursor(), remaining()));
     return input.substr(startPos, position - startPos);
 }
 
-std::string Lexer::readString() {
+std::string_view Lexer::readString() {
+    const CharScanner& scan = charScanner();
     readChar(); // Skip opening quote
     size_t startPos = position;
+    lastStringDecoded = false;
     
-    while (ch != '"' && ch != 0) {
-        readChar();
+    advanceTo(position + scan.findStringStop(cursor(), remaining()));
+    
+    if (ch != '\\') {
+        std::string_view str = input.substr(startPos, position - startPos);
+        if (ch == '"') {
+            readChar(); // Skip closing quote
+        }
+        return str;
     }
     
-    std::string str = input.substr(startPos, position - startPos);
+    // Escapes present: this is the only path that materializes a new string.
+    lastStringDecoded = true;
+    std::string& str = decodedStrings.emplace_back(input.substr(startPos, position - startPos));
+    while (ch == '\\') {
+        readChar();
+        switch (ch) {
+            case 'n': str += '\n'; break;
+            case 't': str += '\t'; break;
+            case 'r': str += '\r'; break;
+            case 0: break;
+            default: str += ch; break; // \\, \" and unknown escapes
+        }
+        if (ch == 0) {
+            break;
+        }
+        readChar();
+        
+        size_t run = scan.findStringStop(cursor(), remaining());
+        str.append(input.substr(position, run));
+        advanceTo(position + run);
+    }
     
     if (ch == '"') {
         readChar(); // Skip closing quote
@@ -73,75 +158,353 @@ std::string Lexer::readString() {
 Token Lexer::nextToken() {
     skipWhitespace();
     
-    Token tok(TokenType::ILLEGAL, std::string(1, ch), line, column);
+    uint32_t start = static_cast<uint32_t>(position < input.length() ? position : input.length());
+    TokenType type = TokenType::ILLEGAL;
     
     switch (ch) {
-        case '=':
-            tok = Token(TokenType::EQUALS, "=", line, column);
-            break;
-        case '+':
-            tok = Token(TokenType::PLUS, "+", line, column);
-            break;
-        case '-':
-            tok = Token(TokenType::MINUS, "-", line, column);
-            break;
-        case '*':
-            tok = Token(TokenType::STAR, "*", line, column);
-            break;
-        case '/':
-            tok = Token(TokenType::SLASH, "/", line, column);
-            break;
-        case '(':
-            tok = Token(TokenType::OPEN_PAREN, "(", line, column);
-            break;
-        case ')':
-            tok = Token(TokenType::CLOSE_PAREN, ")", line, column);
-            break;
-        case '{':
-            tok = Token(TokenType::OPEN_BRACE, "{", line, column);
-            break;
-        case '}':
-            tok = Token(TokenType::CLOSE_BRACE, "}", line, column);
-            break;
-        case ';':
-            tok = Token(TokenType::SEMICOLON, ";", line, column);
-            break;
-        case ',':
-            tok = Token(TokenType::COMMA, ",", line, column);
-            break;
+        case '=': type = TokenType::EQUALS; break;
+        case '+': type = TokenType::PLUS; break;
+        case '-': type = TokenType::MINUS; break;
+        case '*': type = TokenType::STAR; break;
+        case '/': type = TokenType::SLASH; break;
+        case '(': type = TokenType::OPEN_PAREN; break;
+        case ')': type = TokenType::CLOSE_PAREN; break;
+        case '{': type = TokenType::OPEN_BRACE; break;
+        case '}': type = TokenType::CLOSE_BRACE; break;
+        case ';': type = TokenType::SEMICOLON; break;
+        case ',': type = TokenType::COMMA; break;
         case '"':
-            return Token(TokenType::STRING, readString(), line, column);
+            return Token(TokenType::STRING, readString(), start);
         case 0:
-            tok = Token(TokenType::END_OF_FILE, "", line, column);
-            break;
+            return Token(TokenType::END_OF_FILE, std::string_view(), start);
         default:
             if (isdigit(ch)) {
-                return Token(TokenType::NUMBER, readNumber(), line, column);
+                std::string_view text;
+                LiteralValue value = {0.0};
+                TokenType numberType = readNumber(text, value);
+                return Token(numberType, text, start, value);
             } else if (isalpha(ch) || ch == '_') {
-                std::string ident = readIdentifier();
-                
-                // Keywords mapping
-                static std::unordered_map<std::string, TokenType> keywords = {
-                    {"let", TokenType::LET},
-                    {"print", TokenType::PRINT},
-                    {"function", TokenType::FUNCTION},
-                    {"if", TokenType::IF},
-                    {"else", TokenType::ELSE},
-                    {"while", TokenType::WHILE},
-                    {"return", TokenType::RETURN},
-                    {"onClick", TokenType::ONCLICK}
-                };
-                
-                auto it = keywords.find(ident);
-                if (it != keywords.end()) {
-                    return Token(it->second, ident, line, column);
-                } else {
-                    return Token(TokenType::IDENTIFIER, ident, line, column);
-                }
+                std::string_view ident = readIdentifier();
+                return Token(lookupKeyword(ident), ident, start);
             }
             break;
     }
     
+    // Single-character operator, delimiter or illegal character
     readChar();
-    return tok;
-}
\ No newline at end of file
+    return Token(type, input.substr(start, 1), start);
+}
+
+TokenStream Lexer::tokenizeAll() {
+    TokenStream stream;
+    stream.source = input;
+    
+    // Typical scripts average a token every 4-6 bytes
+    size_t estimate = remaining() / 5 + 1;
+    stream.types.reserve(estimate);
+    stream.offsets.reserve(estimate);
+    stream.lengths.reserve(estimate);
+    stream.payloads.reserve(estimate);
+    
+    tokenizeInto(stream, true);
+    return stream;
+}
+
+size_t Lexer::tokenizeInto(TokenStream& stream, bool inputComplete) {
+    size_t end = position;
+    
+    while (true) {
+        Token tok = nextToken();
+        if (!inputComplete && position >= input.length()) {
+            break;
+        }
+        
+        appendToken(stream, tok);
+        end = position;
+        
+        if (tok.type == TokenType::END_OF_FILE) {
+            break;
+        }
+    }
+    
+    decodedStrings.clear();
+    return end < input.length() ? end : input.length();
+}
+
+void Lexer::appendToken(TokenStream& stream, const Token& tok) {
+    uint32_t payload = 0;
+    if (tok.type == TokenType::STRING && lastStringDecoded) {
+        // The decoded text is the newest entry in our storage; move it over
+        stream.decodedStorage.push_back(std::move(decodedStrings.back()));
+        decodedStrings.pop_back();
+        lastStringDecoded = false;
+        payload = static_cast<uint32_t>(stream.decodedStorage.size());
+    } else if (tok.type == TokenType::NUMBER || tok.type == TokenType::INTEGER) {
+        payload = static_cast<uint32_t>(stream.literals.size());
+        stream.literals.push_back(tok.value);
+    }
+    
+    stream.types.push_back(tok.type);
+    stream.offsets.push_back(tok.offset);
+    stream.lengths.push_back(static_cast<uint32_t>(tok.literal.length()));
+    stream.payloads.push_back(payload);
+}
+
+void TokenStream::dropFront(size_t count, uint32_t byteShift) {
+    types.erase(types.begin(), types.begin() + count);
+    offsets.erase(offsets.begin(), offsets.begin() + count);
+    lengths.erase(lengths.begin(), lengths.begin() + count);
+    payloads.erase(payloads.begin(), payloads.begin() + count);
+    
+    // Rebuild the side tables for the surviving tokens only
+    std::deque<std::string> keptStrings;
+    std::vector<LiteralValue> keptLiterals;
+    for (size_t i = 0; i < types.size(); i++) {
+        offsets[i] -= byteShift;
+        if (types[i] == TokenType::STRING && payloads[i]) {
+            keptStrings.push_back(std::move(decodedStorage[payloads[i] - 1]));
+            payloads[i] = static_cast<uint32_t>(keptStrings.size());
+        } else if (types[i] == TokenType::NUMBER || types[i] == TokenType::INTEGER) {
+            keptLiterals.push_back(literals[payloads[i]]);
+            payloads[i] = static_cast<uint32_t>(keptLiterals.size() - 1);
+        }
+    }
+    decodedStorage = std::move(keptStrings);
+    literals = std::move(keptLiterals);
+}
+
+bool StreamingLexer::refill(TokenStream& tokens, size_t keep, size_t lookahead) {
+    // Keep the window bytes from the first token still in use (or, if every
+    // token was consumed, from where lexing resumes)
+    size_t keepOffset = keep < tokens.size() ? tokens.offsets[keep] : resume;
+    size_t drop = keepOffset < resume ? keepOffset : resume;
+    tokens.dropFront(keep, static_cast<uint32_t>(drop));
+    source.discard(drop);
+    resume -= drop;
+    
+    bool ok = true;
+    while (!finished && tokens.size() <= lookahead) {
+        if (!source.readChunk()) {
+            // End the stream here so the parser winds down cleanly
+            tokens.types.push_back(TokenType::END_OF_FILE);
+            tokens.offsets.push_back(static_cast<uint32_t>(resume));
+            tokens.lengths.push_back(0);
+            tokens.payloads.push_back(0);
+            finished = true;
+            ok = false;
+            break;
+        }
+        Lexer lexer(source.view(), resume);
+        resume = lexer.tokenizeInto(tokens, source.atEnd());
+        finished = !tokens.types.empty() && tokens.types.back() == TokenType::END_OF_FILE;
+    }
+    
+    tokens.source = source.view();
+    return ok;
+}
+
+IncrementalLexer::IncrementalLexer(std::string_view source)
+    : buffer(source.begin(), source.end()), gapStart(source.length()), gapEnd(source.length()) {
+    tokens = Lexer(source).tokenizeAll();
+    tokenGapStart = tokenGapEnd = tokens.size();
+}
+
+uint32_t IncrementalLexer::tokenOffset(size_t index) const {
+    if (index < tokenGapStart) {
+        return tokens.offsets[index];
+    }
+    return static_cast<uint32_t>(textLength()) - tokens.offsets[index + (tokenGapEnd - tokenGapStart)];
+}
+
+void IncrementalLexer::moveTextGap(size_t position) {
+    if (position < gapStart) {
+        size_t count = gapStart - position;
+        std::memmove(buffer.data() + gapEnd - count, buffer.data() + position, count);
+        gapStart -= count;
+        gapEnd -= count;
+    } else if (position > gapStart) {
+        size_t count = position - gapStart;
+        std::memmove(buffer.data() + gapStart, buffer.data() + gapEnd, count);
+        gapStart += count;
+        gapEnd += count;
+    }
+}
+
+void IncrementalLexer::reserveTextGap(size_t bytes) {
+    if (gapEnd - gapStart >= bytes) {
+        return;
+    }
+    size_t extra = std::max(bytes, buffer.size() / 8 + 4096);
+    buffer.insert(buffer.begin() + static_cast<std::ptrdiff_t>(gapEnd), extra, '\0');
+    gapEnd += extra;
+}
+
+template <typename T>
+static void moveGapElements(std::vector<T>& v, size_t from, size_t count, size_t to) {
+    std::memmove(v.data() + to, v.data() + from, count * sizeof(T));
+}
+
+void IncrementalLexer::moveTokenGap(size_t index) {
+    uint32_t length = static_cast<uint32_t>(textLength());
+    if (index < tokenGapStart) {
+        // Tokens [index, gapStart) move behind the gap and become end-relative
+        size_t count = tokenGapStart - index;
+        size_t to = tokenGapEnd - count;
+        for (size_t i = index; i < tokenGapStart; i++) {
+            tokens.offsets[i] = length - tokens.offsets[i];
+        }
+        moveGapElements(tokens.types, index, count, to);
+        moveGapElements(tokens.offsets, index, count, to);
+        moveGapElements(tokens.lengths, index, count, to);
+        moveGapElements(tokens.payloads, index, count, to);
+        tokenGapStart -= count;
+        tokenGapEnd -= count;
+    } else if (index > tokenGapStart) {
+        // Tokens after the gap move in front of it and become absolute
+        size_t count = index - tokenGapStart;
+        for (size_t i = tokenGapEnd; i < tokenGapEnd + count; i++) {
+            tokens.offsets[i] = length - tokens.offsets[i];
+        }
+        moveGapElements(tokens.types, tokenGapEnd, count, tokenGapStart);
+        moveGapElements(tokens.offsets, tokenGapEnd, count, tokenGapStart);
+        moveGapElements(tokens.lengths, tokenGapEnd, count, tokenGapStart);
+        moveGapElements(tokens.payloads, tokenGapEnd, count, tokenGapStart);
+        tokenGapStart += count;
+        tokenGapEnd += count;
+    }
+}
+
+void IncrementalLexer::reserveTokenGap(size_t count) {
+    if (tokenGapEnd - tokenGapStart >= count) {
+        return;
+    }
+    size_t extra = std::max(count, tokens.types.size() / 8 + 1024);
+    auto at = static_cast<std::ptrdiff_t>(tokenGapEnd);
+    tokens.types.insert(tokens.types.begin() + at, extra, TokenType::ILLEGAL);
+    tokens.offsets.insert(tokens.offsets.begin() + at, extra, 0);
+    tokens.lengths.insert(tokens.lengths.begin() + at, extra, 0);
+    tokens.payloads.insert(tokens.payloads.begin() + at, extra, 0);
+    tokenGapEnd += extra;
+}
+
+size_t IncrementalLexer::edit(size_t offset, size_t removed, std::string_view inserted) {
+    size_t oldLength = textLength();
+    offset = std::min(offset, oldLength);
+    removed = std::min(removed, oldLength - offset);
+    
+    // Park the token gap in front of the first token at or after the edit,
+    // then also give up the token before it: lexing restarts there. Nothing
+    // in front of that token can change, because a token only ever looks one
+    // byte past its end and the lexer carries no state between tokens.
+    size_t lo = 0;
+    size_t hi = tokenCount();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (tokenOffset(mid) < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    moveTokenGap(lo);
+    size_t restartOffset = 0;
+    if (tokenGapStart > 0) {
+        tokenGapStart--;
+        restartOffset = tokens.offsets[tokenGapStart];
+    }
+    
+    // Apply the edit to the text
+    moveTextGap(offset);
+    gapEnd += removed;
+    reserveTextGap(inserted.length());
+    if (!inserted.empty()) {
+        std::memcpy(buffer.data() + gapStart, inserted.data(), inserted.length());
+        gapStart += inserted.length();
+    }
+    
+    size_t length = textLength();
+    size_t editEnd = offset + inserted.length();
+    
+    // Re-lex a window past the edit, widening it until a new token starts
+    // exactly where an old one did (same distance from the end of the text):
+    // from there on both streams are identical.
+    TokenStream fresh;
+    size_t lexFrom = restartOffset;
+    size_t window = 4096;
+    bool done = false;
+    while (!done) {
+        size_t windowEnd = std::min(length, editEnd + window);
+        bool complete = windowEnd == length;
+        moveTextGap(windowEnd);
+        
+        Lexer lexer(std::string_view(buffer.data(), windowEnd), lexFrom);
+        while (true) {
+            Token tok = lexer.nextToken();
+            if (!complete && lexer.offset() >= windowEnd) {
+                break;
+            }
+            
+            if (tok.offset >= editEnd) {
+                uint32_t distance = static_cast<uint32_t>(length - tok.offset);
+                while (tokenGapEnd < tokens.types.size() && tokens.offsets[tokenGapEnd] > distance) {
+                    tokenGapEnd++;
+                }
+                if (tokenGapEnd < tokens.types.size() && tokens.offsets[tokenGapEnd] == distance) {
+                    done = true;
+                    break;
+                }
+            }
+            
+            lexer.appendToken(fresh, tok);
+            lexFrom = lexer.offset();
+            if (tok.type == TokenType::END_OF_FILE) {
+                done = true;
+                break;
+            }
+        }
+        window *= 2;
+    }
+    
+    // Drop the new tokens into the gap, pointing their payloads at the end
+    // of our side tables
+    reserveTokenGap(fresh.size());
+    uint32_t literalBase = static_cast<uint32_t>(tokens.literals.size());
+    uint32_t decodedBase = static_cast<uint32_t>(tokens.decodedStorage.size());
+    for (size_t i = 0; i < fresh.size(); i++) {
+        uint32_t payload = fresh.payloads[i];
+        if (fresh.types[i] == TokenType::NUMBER || fresh.types[i] == TokenType::INTEGER) {
+            payload += literalBase;
+        } else if (fresh.types[i] == TokenType::STRING && payload) {
+            payload += decodedBase;
+        }
+        tokens.types[tokenGapStart] = fresh.types[i];
+        tokens.offsets[tokenGapStart] = fresh.offsets[i];
+        tokens.lengths[tokenGapStart] = fresh.lengths[i];
+        tokens.payloads[tokenGapStart] = payload;
+        tokenGapStart++;
+    }
+    tokens.literals.insert(tokens.literals.end(), fresh.literals.begin(), fresh.literals.end());
+    for (auto& decoded : fresh.decodedStorage) {
+        tokens.decodedStorage.push_back(std::move(decoded));
+    }
+    
+    return fresh.size();
+}
+
+const TokenStream& IncrementalLexer::stream() {
+    size_t count = tokenCount();
+    moveTokenGap(count);
+    tokens.types.resize(count);
+    tokens.offsets.resize(count);
+    tokens.lengths.resize(count);
+    tokens.payloads.resize(count);
+    tokenGapEnd = count;
+    tokens.source = source();
+    return tokens;
+}
+
+std::string_view IncrementalLexer::source() {
+    size_t length = textLength();
+    moveTextGap(length);
+    return std::string_view(buffer.data(), length);
+}
@@ -1,24 +1,157 @@
 #pragma once
 #include "token.h"
+#include "source.h"
+#include <deque>
 #include <string>
+#include <string_view>
+#include <vector>
 
+/**
+ * TokenStream holds tokens in struct-of-arrays form, filled by
+ * Lexer::tokenizeAll (a whole file) or StreamingLexer (a sliding window).
+ * Token i is (types[i], offsets[i], lengths[i], payloads[i]); offsets are
+ * relative to `source`, which must outlive the stream.
+ */
+struct TokenStream {
+    std::string_view source;
+    std::vector<TokenType> types;
+    std::vector<uint32_t> offsets;   // byte offset of the token start (opening quote for strings)
+    std::vector<uint32_t> lengths;   // length of the token text (string contents, without quotes)
+    std::vector<uint32_t> payloads;  // STRING: 1 + index into `decodedStorage` when escapes were decoded, else 0
+                                     // NUMBER, INTEGER: index into `literals`
+    
+    std::deque<std::string> decodedStorage;
+    std::vector<LiteralValue> literals;
+    
+    size_t size() const { return types.size(); }
+    LiteralValue literal(size_t i) const { return literals[payloads[i]]; }
+    
+    std::string_view text(size_t i) const {
+        if (types[i] == TokenType::STRING) {
+            return payloads[i] ? std::string_view(decodedStorage[payloads[i] - 1]) : source.substr(offsets[i] + 1, lengths[i]);
+        }
+        return source.substr(offsets[i], lengths[i]);
+    }
+    
+    // Forget the first `count` tokens and move the rest `byteShift` bytes
+    // down, for a source window whose first bytes were discarded.
+    void dropFront(size_t count, uint32_t byteShift);
+};
+
+/**
+ * Lexer scans a caller-owned source buffer without copying it. Tokens it
+ * returns reference that buffer, so the buffer must outlive every token.
+ */
 class Lexer {
 private:
-    std::string input;
+    std::string_view input;
     size_t position;
     size_t readPosition;
     char ch;
-    int line;
-    int column;
+    
+    // Backing storage for string literals whose escapes had to be decoded.
+    // A deque keeps earlier entries stable while new ones are appended.
+    std::deque<std::string> decodedStrings;
+    bool lastStringDecoded;
 
     void readChar();
+    void advanceTo(size_t target);
+    const char* cursor() const;
+    size_t remaining() const;
     void skipWhitespace();
-    std::string readNumber();
-    std::string readIdentifier();
-    std::string readString();
+    TokenType readNumber(std::string_view& text, LiteralValue& value);
+    std::string_view readIdentifier();
+    std::string_view readString();
     char peekChar();
 
 public:
-    Lexer(const std::string& input);
+    Lexer(std::string_view input, size_t start = 0);
     Token nextToken();
-};
\ No newline at end of file
+    // Offset just past the last token returned
+    size_t offset() const { return position < input.length() ? position : input.length(); }
+    
+    // Lex everything that is left in one pass. The stream takes over the
+    // lexer's decoded-string storage, so it stays valid after the lexer dies.
+    TokenStream tokenizeAll();
+    
+    // Append tokens to `stream`. When `inputComplete` is false the input is a
+    // window that continues past its end, so lexing stops before the first
+    // token that reaches the end of the window (it may be cut off). Returns
+    // the offset just past the last token appended.
+    size_t tokenizeInto(TokenStream& stream, bool inputComplete);
+    
+    // Append `tok`, which must be the token nextToken() just returned, to
+    // `stream`, moving its decoded string (if any) along with it.
+    void appendToken(TokenStream& stream, const Token& tok);
+};
+
+/**
+ * StreamingLexer lexes a ChunkedSource into a TokenStream that only holds a
+ * window of tokens. Callers consume tokens from the front and call refill()
+ * when they run low; tokens cut off by a chunk boundary are re-lexed once
+ * the next chunk has arrived.
+ */
+class StreamingLexer {
+private:
+    ChunkedSource& source;
+    size_t resume;  // window offset where lexing continues
+    bool finished;  // END_OF_FILE has been appended
+
+public:
+    explicit StreamingLexer(ChunkedSource& source) : source(source), resume(0), finished(false) {}
+    
+    // Drop tokens before index `keep`, slide the window past them, and lex
+    // until more than `lookahead` tokens are buffered or the input ends.
+    // Returns false on a read error.
+    bool refill(TokenStream& tokens, size_t keep, size_t lookahead);
+    bool exhausted() const { return finished; }
+    SourcePosition locate(uint32_t offset) const { return source.locate(offset); }
+    // Input bytes before the current window, for turning token offsets into input offsets
+    size_t discardedBytes() const { return source.discardedBytes(); }
+};
+
+/**
+ * IncrementalLexer owns a text buffer and its tokens and keeps them in sync
+ * across edits. Each edit re-lexes only from the last token before the edit
+ * until the new tokens line up with the old ones again, and splices the
+ * result in.
+ *
+ * The text and the token arrays are gap buffers with their gaps kept at the
+ * last edit. Tokens behind the token gap store their distance from the end
+ * of the text instead of an offset, so an edit never touches the tokens
+ * after it. A run of nearby edits therefore costs time proportional to the
+ * edits, not to the file; jumping elsewhere costs one memmove to the new spot.
+ *
+ * Side-table entries (decoded strings, numeric literals) of replaced tokens
+ * are not reclaimed; construct a new IncrementalLexer to compact them.
+ */
+class IncrementalLexer {
+private:
+    std::vector<char> buffer;  // text == buffer[0, gapStart) + buffer[gapEnd, end)
+    size_t gapStart;
+    size_t gapEnd;
+    
+    TokenStream tokens;        // arrays hold a gap [tokenGapStart, tokenGapEnd)
+    size_t tokenGapStart;
+    size_t tokenGapEnd;
+    
+    size_t textLength() const { return buffer.size() - (gapEnd - gapStart); }
+    size_t tokenCount() const { return tokens.types.size() - (tokenGapEnd - tokenGapStart); }
+    uint32_t tokenOffset(size_t index) const;
+    void moveTextGap(size_t position);
+    void reserveTextGap(size_t bytes);
+    void moveTokenGap(size_t index);
+    void reserveTokenGap(size_t count);
+
+public:
+    explicit IncrementalLexer(std::string_view source);
+    
+    // Replace `removed` bytes at `offset` with `inserted`. Returns how many
+    // tokens were re-lexed.
+    size_t edit(size_t offset, size_t removed, std::string_view inserted);
+    
+    // Close the gaps and expose the text / tokens contiguously. Both stay
+    // valid until the next edit.
+    std::string_view source();
+    const TokenStream& stream();
+};
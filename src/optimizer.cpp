@@ -0,0 +1,462 @@
+#include "optimizer.h"
+#include "interpreter.h"
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+static bool isLiteral(const Expression* expr) {
+    return expr && (expr->kind == NodeKind::NUMBER || expr->kind == NodeKind::INTEGER ||
+                    expr->kind == NodeKind::STRING);
+}
+
+static Value literalValue(const Expression* expr) {
+    switch (expr->kind) {
+        case NodeKind::NUMBER: return static_cast<const NumberLiteral*>(expr)->value;
+        case NodeKind::INTEGER: return static_cast<const IntegerLiteral*>(expr)->value;
+        default: return Value::string(static_cast<const StringLiteral*>(expr)->value);
+    }
+}
+
+// Folded values are never bool: literals only produce numbers and strings.
+// The literal takes the span of the expression it replaces.
+static Expression* makeLiteral(Arena& arena, const Value& value, SourceSpan span) {
+    Expression* literal;
+    if (value.isInteger()) {
+        literal = arena.make<IntegerLiteral>(value.asInteger());
+    } else if (value.isDouble()) {
+        literal = arena.make<NumberLiteral>(value.asDouble());
+    } else {
+        literal = arena.make<StringLiteral>(arena.copyString(value.asString().view()));
+    }
+    literal->setSpan(span);
+    return literal;
+}
+
+// Apply `rewrite` to every expression a statement owns, recursing into
+// nested bodies (function bodies only when asked)
+template <typename Rewrite>
+static void rewriteStatement(Statement* stmt, Rewrite& rewrite, bool intoFunctions) {
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->kind) {
+        case NodeKind::EXPRESSION_STATEMENT: {
+            auto* exprStmt = static_cast<ExpressionStatement*>(stmt);
+            exprStmt->expression = rewrite(exprStmt->expression);
+            break;
+        }
+        case NodeKind::LET: {
+            auto* let = static_cast<LetStatement*>(stmt);
+            let->value = rewrite(let->value);
+            break;
+        }
+        case NodeKind::BLOCK:
+            for (Statement* inner : static_cast<BlockStatement*>(stmt)->statements) {
+                rewriteStatement(inner, rewrite, intoFunctions);
+            }
+            break;
+        case NodeKind::FUNCTION:
+            if (intoFunctions) {
+                rewriteStatement(static_cast<FunctionDeclaration*>(stmt)->body, rewrite, intoFunctions);
+            }
+            break;
+        case NodeKind::ONCLICK:
+            rewriteStatement(static_cast<OnClickStatement*>(stmt)->body, rewrite, intoFunctions);
+            break;
+        case NodeKind::RETURN: {
+            auto* ret = static_cast<ReturnStatement*>(stmt);
+            ret->value = rewrite(ret->value);
+            break;
+        }
+        case NodeKind::IF: {
+            auto* branch = static_cast<IfStatement*>(stmt);
+            branch->condition = rewrite(branch->condition);
+            rewriteStatement(branch->consequence, rewrite, intoFunctions);
+            rewriteStatement(branch->alternative, rewrite, intoFunctions);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Visits every expression under a root, children before parents, handing
+// `visit` the slot that holds each one so it may replace the node. Like
+// FlatBuilder, the walk recurses for ordinary trees and past
+// RECURSION_LIMIT keeps its own stack, so a chain of a million additions
+// folds in bounded native stack. One walker serves a whole pass run.
+class ExpressionWalker {
+private:
+    struct Visit {
+        Expression** slot;
+        uint32_t next;  // the child to visit next
+    };
+
+    std::vector<Visit> stack;
+
+    // Past this depth the walk stops recursing and keeps its own stack
+    static constexpr size_t RECURSION_LIMIT = 4096;
+
+    // The slot of the index'th child, or nullptr past the last. Callees are
+    // children only when asked: they name functions, not values.
+    static Expression** childAt(Expression* expr, uint32_t index, bool callees) {
+        switch (expr->kind) {
+            case NodeKind::BINARY: {
+                auto* binary = static_cast<BinaryExpression*>(expr);
+                return index == 0 ? &binary->left : index == 1 ? &binary->right : nullptr;
+            }
+            case NodeKind::CALL: {
+                auto* call = static_cast<CallExpression*>(expr);
+                if (callees) {
+                    if (index == 0) {
+                        return &call->function;
+                    }
+                    index--;
+                }
+                return index < call->arguments.size() ? &call->arguments[index] : nullptr;
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    template <typename Visitor>
+    void walk(Expression*& slot, Visitor& visit, bool callees, size_t depth) {
+        Expression* expr = slot;
+        if (!expr) {
+            return;
+        }
+        if (depth == RECURSION_LIMIT) {
+            walkIteratively(slot, visit, callees);
+            return;
+        }
+        if (expr->kind == NodeKind::BINARY) {
+            auto* binary = static_cast<BinaryExpression*>(expr);
+            walk(binary->left, visit, callees, depth + 1);
+            walk(binary->right, visit, callees, depth + 1);
+        } else if (expr->kind == NodeKind::CALL) {
+            auto* call = static_cast<CallExpression*>(expr);
+            if (callees) {
+                walk(call->function, visit, callees, depth + 1);
+            }
+            for (Expression*& arg : call->arguments) {
+                walk(arg, visit, callees, depth + 1);
+            }
+        }
+        visit(slot);
+    }
+
+    template <typename Visitor>
+    void walkIteratively(Expression*& root, Visitor& visit, bool callees) {
+        stack.push_back(Visit{&root, 0});
+        while (!stack.empty()) {
+            Visit& top = stack.back();
+            Expression** child = childAt(*top.slot, top.next++, callees);
+            if (!child) {
+                Expression*& done = *top.slot;
+                stack.pop_back();
+                visit(done);
+            } else if (*child) {
+                stack.push_back(Visit{child, 0});
+            }
+        }
+    }
+
+public:
+    template <typename Visitor>
+    void postOrder(Expression*& root, Visitor&& visit, bool callees = false) {
+        walk(root, visit, callees, 0);
+    }
+};
+
+// Constant folding
+
+// Replaces a binary expression whose operands are both literals (having
+// been folded first) by its value
+static void foldNode(Expression*& expr, Arena& arena, size_t& rewrites) {
+    if (expr->kind != NodeKind::BINARY) {
+        return;
+    }
+    auto* binary = static_cast<BinaryExpression*>(expr);
+    Value result;
+    if (isLiteral(binary->left) && isLiteral(binary->right) &&
+        Interpreter::binaryOperation(binary->operator_, literalValue(binary->left),
+                                     literalValue(binary->right), result)) {
+        rewrites++;
+        expr = makeLiteral(arena, result, expr->span());
+    }
+}
+
+static Expression* fold(Expression* expr, ExpressionWalker& walker, Arena& arena, size_t& rewrites) {
+    walker.postOrder(expr, [&](Expression*& node) { foldNode(node, arena, rewrites); });
+    return expr;
+}
+
+size_t ConstantFoldingPass::run(PassContext& context) {
+    size_t rewrites = 0;
+    Arena& arena = context.program.arena;
+    ExpressionWalker walker;
+    auto rewrite = [&](Expression* expr) { return fold(expr, walker, arena, rewrites); };
+    for (Statement* stmt : context.program.statements) {
+        rewriteStatement(stmt, rewrite, true);
+    }
+    return rewrites;
+}
+
+// Constant propagation
+
+static void countBindings(Statement* stmt, std::unordered_map<Symbol, int>& bindings) {
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->kind) {
+        case NodeKind::LET:
+            bindings[static_cast<LetStatement*>(stmt)->name]++;
+            break;
+        case NodeKind::BLOCK:
+            for (Statement* inner : static_cast<BlockStatement*>(stmt)->statements) {
+                countBindings(inner, bindings);
+            }
+            break;
+        case NodeKind::FUNCTION: {
+            auto* func = static_cast<FunctionDeclaration*>(stmt);
+            for (Symbol param : func->parameters) {
+                bindings[param]++;
+            }
+            countBindings(func->body, bindings);
+            break;
+        }
+        case NodeKind::ONCLICK:
+            countBindings(static_cast<OnClickStatement*>(stmt)->body, bindings);
+            break;
+        case NodeKind::IF:
+            countBindings(static_cast<IfStatement*>(stmt)->consequence, bindings);
+            countBindings(static_cast<IfStatement*>(stmt)->alternative, bindings);
+            break;
+        default:
+            break;
+    }
+}
+
+static Expression* substitute(Expression* expr, ExpressionWalker& walker,
+                              const std::unordered_map<Symbol, Expression*>& constants, Arena& arena,
+                              size_t& rewrites) {
+    // Callees are skipped: they name functions, not values
+    walker.postOrder(expr, [&](Expression*& node) {
+        if (node->kind != NodeKind::IDENTIFIER) {
+            return;
+        }
+        auto it = constants.find(static_cast<Identifier*>(node)->name);
+        if (it != constants.end()) {
+            rewrites++;
+            // A fresh node per use, so later passes may rewrite each freely
+            node = makeLiteral(arena, literalValue(it->second), node->span());
+        }
+    });
+    return expr;
+}
+
+size_t ConstantPropagationPass::run(PassContext& context) {
+    if (!context.wholeProgram) {
+        return 0;
+    }
+    Program& program = context.program;
+
+    std::unordered_map<Symbol, int> bindings;
+    for (Statement* stmt : program.statements) {
+        countBindings(stmt, bindings);
+    }
+
+    std::unordered_map<Symbol, Expression*> constants;
+    std::vector<OnClickStatement*> handlers;
+    size_t rewrites = 0;
+    ExpressionWalker walker;
+    auto rewrite = [&](Expression* expr) { return substitute(expr, walker, constants, program.arena, rewrites); };
+
+    // Top level in order, so each read only sees bindings made before it
+    for (Statement* stmt : program.statements) {
+        if (!stmt) {
+            continue;
+        }
+        if (stmt->kind == NodeKind::ONCLICK) {
+            handlers.push_back(static_cast<OnClickStatement*>(stmt));
+        } else if (stmt->kind != NodeKind::FUNCTION) {
+            rewriteStatement(stmt, rewrite, false);
+        }
+
+        if (stmt->kind == NodeKind::LET) {
+            // Fold the substituted value right away, so a chain of lets
+            // each built from the last collapses in one pass, not one
+            // link per optimizer round
+            auto* let = static_cast<LetStatement*>(stmt);
+            let->value = fold(let->value, walker, program.arena, rewrites);
+            if (bindings[let->name] == 1 && isLiteral(let->value)) {
+                constants[let->name] = let->value;
+            }
+        }
+    }
+
+    // Handlers run after the whole program, so they see every binding
+    for (OnClickStatement* handler : handlers) {
+        rewriteStatement(handler, rewrite, false);
+    }
+    return rewrites;
+}
+
+// Dead expression elimination
+
+// Evaluating it can neither print nor report an error
+static bool isPure(Expression* expr, ExpressionWalker& walker) {
+    if (isLiteral(expr)) {
+        return true;
+    }
+    if (!expr || expr->kind != NodeKind::BINARY) {
+        return false;
+    }
+    bool pure = true;
+    walker.postOrder(expr, [&](Expression*& node) {
+        if (node->kind == NodeKind::BINARY) {
+            auto* binary = static_cast<BinaryExpression*>(node);
+            pure = pure && binary->operator_ != BinaryOperator::DIVIDE && binary->left && binary->right;
+        } else {
+            pure = pure && isLiteral(node);
+        }
+    }, true);
+    return pure;
+}
+
+static void countReads(Expression* expr, ExpressionWalker& walker, std::unordered_map<Symbol, size_t>& reads) {
+    walker.postOrder(expr, [&](Expression*& node) {
+        if (node->kind == NodeKind::IDENTIFIER) {
+            reads[static_cast<Identifier*>(node)->name]++;
+        }
+    }, true);
+}
+
+static ArenaArray<Statement*> prune(ArenaArray<Statement*> statements, bool topLevel, const PassContext& context,
+                                    ExpressionWalker& walker, const std::unordered_map<Symbol, size_t>& reads,
+                                    size_t& rewrites) {
+    std::vector<Statement*> kept;
+    for (Statement* stmt : statements) {
+        if (stmt && stmt->kind == NodeKind::EXPRESSION_STATEMENT &&
+            isPure(static_cast<ExpressionStatement*>(stmt)->expression, walker)) {
+            continue;
+        }
+        if (stmt && topLevel && context.wholeProgram && stmt->kind == NodeKind::LET) {
+            auto* let = static_cast<LetStatement*>(stmt);
+            if (isLiteral(let->value) && reads.find(let->name) == reads.end()) {
+                continue;
+            }
+        }
+
+        if (stmt && stmt->kind == NodeKind::ONCLICK) {
+            BlockStatement* body = static_cast<OnClickStatement*>(stmt)->body;
+            body->statements = prune(body->statements, false, context, walker, reads, rewrites);
+        } else if (stmt && stmt->kind == NodeKind::FUNCTION && static_cast<FunctionDeclaration*>(stmt)->body) {
+            BlockStatement* body = static_cast<FunctionDeclaration*>(stmt)->body;
+            body->statements = prune(body->statements, false, context, walker, reads, rewrites);
+        }
+        kept.push_back(stmt);
+    }
+
+    if (kept.size() == statements.size()) {
+        return statements;
+    }
+    rewrites += statements.size() - kept.size();
+    return context.program.arena.copyArray(kept);
+}
+
+size_t DeadExpressionPass::run(PassContext& context) {
+    std::unordered_map<Symbol, size_t> reads;
+    ExpressionWalker walker;
+    if (context.wholeProgram) {
+        auto count = [&](Expression* expr) {
+            countReads(expr, walker, reads);
+            return expr;
+        };
+        for (Statement* stmt : context.program.statements) {
+            rewriteStatement(stmt, count, true);
+        }
+    }
+
+    size_t rewrites = 0;
+    context.program.statements = prune(context.program.statements, true, context, walker, reads, rewrites);
+    return rewrites;
+}
+
+// Optimizer
+
+Optimizer::Optimizer() {
+    passes.push_back(std::make_unique<ConstantFoldingPass>());
+    passes.push_back(std::make_unique<ConstantPropagationPass>());
+    passes.push_back(std::make_unique<DeadExpressionPass>());
+    enabled.assign(passes.size(), true);
+}
+
+bool Optimizer::disable(const std::string& name) {
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (name == passes[i]->name()) {
+            enabled[i] = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Optimizer::disableAll() {
+    enabled.assign(passes.size(), false);
+}
+
+std::string Optimizer::passNames() const {
+    std::string names;
+    for (const auto& pass : passes) {
+        if (!names.empty()) names += ", ";
+        names += pass->name();
+    }
+    return names;
+}
+
+std::string Optimizer::enabledPassNames() const {
+    std::string names;
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (!enabled[i]) continue;
+        if (!names.empty()) names += ",";
+        names += passes[i]->name();
+    }
+    return names;
+}
+
+std::vector<PassStats> Optimizer::run(Program& program, bool wholeProgram) {
+    std::vector<PassStats> stats;
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (enabled[i]) {
+            stats.push_back(PassStats{passes[i]->name(), 0, 0.0});
+        }
+    }
+
+    PassContext context{program, wholeProgram};
+    size_t total = 0;
+    for (int round = 0; round < MAX_ROUNDS; round++) {
+        size_t changed = 0;
+        size_t slot = 0;
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (!enabled[i]) continue;
+            auto start = std::chrono::steady_clock::now();
+            size_t rewrites = passes[i]->run(context);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            stats[slot].rewrites += rewrites;
+            stats[slot].milliseconds += elapsed.count();
+            slot++;
+            changed += rewrites;
+        }
+        total += changed;
+        if (changed == 0) break;
+    }
+
+    // Folding never adds nodes, so nodeCount still bounds the rebuild
+    if (total > 0) {
+        program.flat = FlatAST::build(program);
+        program.nodeCount = program.flat.size();
+    }
+    return stats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "ast.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct PassContext {
+    Program& program;
+    // True when the Program is a whole script (a file or -e). Interactive
+    // mode runs each line as its own Program against one shared
+    // environment, so what one line binds can change under the next, and
+    // passes that reason about bindings must stand down.
+    bool wholeProgram;
+};
+
+/**
+ * An OptimizationPass rewrites a Program's tree in place without changing
+ * what it prints or which runtime errors it reports. Replacement nodes are
+ * allocated in the Program's arena; nodes that drop out are just no longer
+ * referenced. run() returns the number of rewrites made.
+ */
+class OptimizationPass {
+public:
+    virtual ~OptimizationPass() = default;
+    virtual const char* name() const = 0;
+    virtual size_t run(PassContext& context) = 0;
+};
+
+// "fold": evaluates + - * / on numeric and string literals at compile
+// time, with the interpreter's own arithmetic. Division by zero is left
+// in place so it still reports at run time.
+class ConstantFoldingPass : public OptimizationPass {
+public:
+    const char* name() const override { return "fold"; }
+    size_t run(PassContext& context) override;
+};
+
+// "propagate": replaces reads of a name bound exactly once in the program,
+// by a top-level let of a literal, with that literal. Top-level reads are
+// replaced only after the binding (earlier ones are runtime errors), and
+// onClick bodies, which run after the program, are replaced throughout.
+class ConstantPropagationPass : public OptimizationPass {
+public:
+    const char* name() const override { return "propagate"; }
+    size_t run(PassContext& context) override;
+};
+
+// "dce": drops expression statements with no effect (literals, and
+// arithmetic over them that cannot fail) and, in whole programs, top-level
+// lets of literals whose name is never read.
+class DeadExpressionPass : public OptimizationPass {
+public:
+    const char* name() const override { return "dce"; }
+    size_t run(PassContext& context) override;
+};
+
+struct PassStats {
+    const char* name;
+    size_t rewrites;
+    double milliseconds;
+};
+
+/**
+ * Optimizer runs between parsing and execution. It repeats its passes, in
+ * order, until a round changes nothing (folding exposes constants to
+ * propagate and vice versa), then rebuilds the Program's flat AST so the
+ * interpreter sees the result.
+ */
+class Optimizer {
+private:
+    std::vector<std::unique_ptr<OptimizationPass>> passes;
+    std::vector<bool> enabled;
+
+    static constexpr int MAX_ROUNDS = 8;
+
+public:
+    Optimizer();
+
+    // Returns false if no pass has that name
+    bool disable(const std::string& name);
+    void disableAll();
+    std::string passNames() const;
+    // The passes run() will apply, e.g. "fold,dce"; part of the cache key
+    std::string enabledPassNames() const;
+
+    // Totals per enabled pass, in pipeline order
+    std::vector<PassStats> run(Program& program, bool wholeProgram);
+};
@@ -1,101 +1,171 @@
 #include "parser.h"
+#include <algorithm>
+#include <array>
 #include <iostream>
 
-Parser::Parser(const std::string& input) : lexer(input), currentToken(TokenType::ILLEGAL, "", 1, 1), peekToken(TokenType::ILLEGAL, "", 1, 1) {
-    nextToken();
-    nextToken();
+Parser::Parser(std::string_view input, uint32_t base) : Parser(Lexer(input).tokenizeAll(), base) {}
+
+Parser::Parser(TokenStream stream, uint32_t base)
+    : tokens(std::move(stream)), current(0), stream(nullptr), arena(nullptr), nodeCount(0), base(base),
+      windowBase(base), nesting(0) {}
+
+Parser::Parser(StreamingLexer& streamingLexer, uint32_t base)
+    : current(0), stream(&streamingLexer), arena(nullptr), nodeCount(0), base(base), windowBase(base), nesting(0) {
+    if (!stream->refill(tokens, 0, STREAM_LOOKAHEAD)) {
+        addError("Read error while streaming input");
+    }
 }
 
 void Parser::nextToken() {
-    currentToken = peekToken;
-    peekToken = lexer.nextToken();
+    // The stream always ends with END_OF_FILE; stay parked on it
+    if (current + 1 < tokens.size()) {
+        current++;
+    }
+    
+    if (stream && tokens.size() - current <= STREAM_LOOKAHEAD && !stream->exhausted()) {
+        if (!stream->refill(tokens, current, STREAM_LOOKAHEAD)) {
+            addError("Read error while streaming input");
+        }
+        current = 0;
+        windowBase = base + static_cast<uint32_t>(stream->discardedBytes());
+    }
+}
+
+uint32_t Parser::tokenEnd(size_t i) const {
+    if (tokens.types[i] != TokenType::STRING) {
+        return tokenStart(i) + tokens.lengths[i];
+    }
+    // String lengths count the contents only, and decoded contents are
+    // shorter than their escapes, so find the closing quote in the source
+    std::string_view source = tokens.source;
+    size_t position = tokens.offsets[i] + 1;
+    if (tokens.payloads[i]) {
+        while (position < source.length() && source[position] != '"') {
+            position += source[position] == '\\' ? 2 : 1;
+        }
+        position = std::min(position, source.length());
+    } else {
+        position += tokens.lengths[i];
+    }
+    if (position < source.length() && source[position] == '"') {
+        position++;
+    }
+    return tokenStart(i) + static_cast<uint32_t>(position - tokens.offsets[i]);
 }
 
 bool Parser::expectPeek(TokenType type) {
-    if (peekToken.type == type) {
+    if (peekType() == type) {
         nextToken();
         return true;
     } else {
-        addError("Expected " + tokenTypeToString(type) + ", got " + tokenTypeToString(peekToken.type));
+        addError("Expected " + tokenTypeToString(type) + ", got " + tokenTypeToString(peekType()));
         return false;
     }
 }
 
 void Parser::addError(const std::string& message) {
-    errors.push_back("Line " + std::to_string(currentToken.line) + ": " + message);
+    uint32_t offset = current < tokens.size() ? tokens.offsets[current] : 0;
+    SourcePosition pos;
+    if (stream) {
+        pos = stream->locate(offset);
+    } else {
+        if (!lineIndex) {
+            lineIndex = std::make_unique<LineIndex>(tokens.source);
+        }
+        pos = lineIndex->locate(offset);
+    }
+    errors.push_back("Line " + std::to_string(pos.line) + ", column " + std::to_string(pos.column) + ": " + message);
 }
 
 std::unique_ptr<Program> Parser::parseProgram() {
     auto program = std::make_unique<Program>();
+    arena = &program->arena;
+    nodeCount = 0;
     
-    while (currentToken.type != TokenType::END_OF_FILE) {
-        auto stmt = parseStatement();
+    while (currentType() != TokenType::END_OF_FILE) {
+        Statement* stmt = parseStatement();
         if (stmt) {
-            program->statements.push_back(std::move(stmt));
+            pendingStatements.push_back(stmt);
         }
         nextToken();
     }
     
+    program->statements = arena->copyArray(pendingStatements);
+    pendingStatements.clear();
+    // END_OF_FILE sits at the end of the input
+    program->setSpan(SourceSpan{base, tokenStart(current) - base});
+    arena = nullptr;
+    program->nodeCount = nodeCount + 1;
+    program->flat = FlatAST::build(*program);
     return program;
 }
 
-std::unique_ptr<Statement> Parser::parseStatement() {
-    switch (currentToken.type) {
+Statement* Parser::parseStatement() {
+    switch (currentType()) {
         case TokenType::LET:
             return parseLetStatement();
         case TokenType::FUNCTION:
             return parseFunctionDeclaration();
         case TokenType::ONCLICK:
             return parseOnClickStatement();
+        case TokenType::RETURN:
+            return parseReturnStatement();
+        case TokenType::IF:
+            return parseIfStatement();
         default:
             return parseExpressionStatement();
     }
 }
 
-std::unique_ptr<LetStatement> Parser::parseLetStatement() {
+LetStatement* Parser::parseLetStatement() {
+    uint32_t start = tokenStart(current);
     if (!expectPeek(TokenType::IDENTIFIER)) {
         return nullptr;
     }
     
-    std::string name = currentToken.literal;
+    Symbol name = symbols().intern(currentText());
     
     if (!expectPeek(TokenType::EQUALS)) {
         return nullptr;
     }
     
     nextToken();
-    auto value = parseExpression();
+    Expression* value = parseExpression();
     
-    if (peekToken.type == TokenType::SEMICOLON) {
+    if (peekType() == TokenType::SEMICOLON) {
         nextToken();
     }
     
-    return std::make_unique<LetStatement>(name, std::move(value));
+    return makeNode<LetStatement>(spanTo(start), name, value);
 }
 
-std::unique_ptr<FunctionDeclaration> Parser::parseFunctionDeclaration() {
+FunctionDeclaration* Parser::parseFunctionDeclaration() {
+    uint32_t start = tokenStart(current);
     if (!expectPeek(TokenType::IDENTIFIER)) {
         return nullptr;
     }
     
-    auto func = std::make_unique<FunctionDeclaration>(currentToken.literal);
+    Symbol name = symbols().intern(currentText());
     
     if (!expectPeek(TokenType::OPEN_PAREN)) {
         return nullptr;
     }
     
     // Parse parameters
-    if (peekToken.type != TokenType::CLOSE_PAREN) {
+    if (peekType() != TokenType::CLOSE_PAREN) {
         nextToken();
-        func->parameters.push_back(currentToken.literal);
+        pendingParameters.push_back(symbols().intern(currentText()));
         
-        while (peekToken.type == TokenType::COMMA) {
+        while (peekType() == TokenType::COMMA) {
             nextToken();
             nextToken();
-            func->parameters.push_back(currentToken.literal);
+            pendingParameters.push_back(symbols().intern(currentText()));
         }
     }
     
+    ArenaArray<Symbol> parameters = arena->copyArray(pendingParameters);
+    pendingParameters.clear();
+    
     if (!expectPeek(TokenType::CLOSE_PAREN)) {
         return nullptr;
     }
@@ -104,12 +174,13 @@ std::unique_ptr<FunctionDeclaration> Parser::parseFunctionDeclaration() {
         return nullptr;
     }
     
-    func->body = parseBlockStatement();
+    BlockStatement* body = parseBlockStatement();
     
-    return func;
+    return makeNode<FunctionDeclaration>(spanTo(start), name, parameters, body);
 }
 
-std::unique_ptr<OnClickStatement> Parser::parseOnClickStatement() {
+OnClickStatement* Parser::parseOnClickStatement() {
+    uint32_t start = tokenStart(current);
     if (!expectPeek(TokenType::OPEN_PAREN)) {
         return nullptr;
     }
@@ -118,7 +189,7 @@ std::unique_ptr<OnClickStatement> Parser::parseOnClickStatement() {
         return nullptr;
     }
     
-    std::string elementId = currentToken.literal;
+    Symbol elementId = symbols().intern(currentText());
     
     if (!expectPeek(TokenType::CLOSE_PAREN)) {
         return nullptr;
@@ -128,121 +199,345 @@ std::unique_ptr<OnClickStatement> Parser::parseOnClickStatement() {
         return nullptr;
     }
     
-    auto body = parseBlockStatement();
+    BlockStatement* body = parseBlockStatement();
     
-    return std::make_unique<OnClickStatement>(elementId, std::move(body));
+    return makeNode<OnClickStatement>(spanTo(start), elementId, body);
 }
 
-std::unique_ptr<ExpressionStatement> Parser::parseExpressionStatement() {
-    auto expr = parseExpression();
+ReturnStatement* Parser::parseReturnStatement() {
+    uint32_t start = tokenStart(current);
+    Expression* value = nullptr;
+    
+    // A bare return ends at its semicolon, or at the end of its block
+    if (peekType() != TokenType::SEMICOLON && peekType() != TokenType::CLOSE_BRACE &&
+        peekType() != TokenType::END_OF_FILE) {
+        nextToken();
+        value = parseExpression();
+    }
     
-    if (peekToken.type == TokenType::SEMICOLON) {
+    if (peekType() == TokenType::SEMICOLON) {
         nextToken();
     }
     
-    return std::make_unique<ExpressionStatement>(std::move(expr));
+    return makeNode<ReturnStatement>(spanTo(start), value);
 }
 
-std::unique_ptr<BlockStatement> Parser::parseBlockStatement() {
-    auto block = std::make_unique<BlockStatement>();
+IfStatement* Parser::parseIfStatement() {
+    uint32_t start = tokenStart(current);
+    if (!expectPeek(TokenType::OPEN_PAREN)) {
+        return nullptr;
+    }
     
     nextToken();
+    Expression* condition = parseExpression();
     
-    while (currentToken.type != TokenType::CLOSE_BRACE && currentToken.type != TokenType::END_OF_FILE) {
-        auto stmt = parseStatement();
-        if (stmt) {
-            block->statements.push_back(std::move(stmt));
-        }
+    if (!expectPeek(TokenType::CLOSE_PAREN)) {
+        return nullptr;
+    }
+    
+    if (!expectPeek(TokenType::OPEN_BRACE)) {
+        return nullptr;
+    }
+    
+    BlockStatement* consequence = parseBlockStatement();
+    Statement* alternative = nullptr;
+    
+    if (peekType() == TokenType::ELSE) {
         nextToken();
+        if (peekType() == TokenType::IF) {
+            nextToken();
+            // Each else-if nests inside the one before it
+            if (enterNested()) {
+                alternative = parseIfStatement();
+                nesting--;
+            }
+        } else if (expectPeek(TokenType::OPEN_BRACE)) {
+            alternative = parseBlockStatement();
+        }
     }
     
-    return block;
+    return makeNode<IfStatement>(spanTo(start), condition, consequence, alternative);
 }
 
-std::unique_ptr<Expression> Parser::parseExpression(int precedence) {
-    auto left = parsePrimaryExpression();
+ExpressionStatement* Parser::parseExpressionStatement() {
+    uint32_t start = tokenStart(current);
+    Expression* expr = parseExpression();
     
-    while (peekToken.type != TokenType::SEMICOLON && getOperatorPrecedence(peekToken.type) > precedence) {
-        TokenType op = peekToken.type;
+    if (peekType() == TokenType::SEMICOLON) {
         nextToken();
-        
-        std::string operator_ = currentToken.literal;
-        int rightPrec = getOperatorPrecedence(op);
-        
+    }
+    
+    return makeNode<ExpressionStatement>(spanTo(start), expr);
+}
+
+BlockStatement* Parser::parseBlockStatement() {
+    uint32_t start = tokenStart(current);
+    if (!enterNested()) {
+        return makeNode<BlockStatement>(spanTo(start), ArenaArray<Statement*>());
+    }
+    size_t first = pendingStatements.size();
+    
+    nextToken();
+    
+    while (currentType() != TokenType::CLOSE_BRACE && currentType() != TokenType::END_OF_FILE) {
+        Statement* stmt = parseStatement();
+        if (stmt) {
+            pendingStatements.push_back(stmt);
+        }
         nextToken();
-        auto right = parseExpression(rightPrec);
-        
-        left = std::make_unique<BinaryExpression>(std::move(left), operator_, std::move(right));
     }
     
-    return left;
+    ArenaArray<Statement*> statements = arena->copyArray(pendingStatements, first);
+    pendingStatements.resize(first);
+    nesting--;
+    return makeNode<BlockStatement>(spanTo(start), statements);
 }
 
-std::unique_ptr<Expression> Parser::parsePrimaryExpression() {
-    switch (currentToken.type) {
-        case TokenType::NUMBER: {
-            double value = std::stod(currentToken.literal);
-            return std::make_unique<NumberLiteral>(value);
+// Statements nest by recursion here and in every stage after parsing, so
+// their depth is capped rather than given explicit stacks like
+// expressions. No program written by hand comes close.
+static constexpr size_t STATEMENT_NESTING_LIMIT = 1024;
+
+bool Parser::enterNested() {
+    if (nesting == STATEMENT_NESTING_LIMIT) {
+        addError("Statements nested too deeply");
+        // Every block still open would misparse its closing braces
+        while (currentType() != TokenType::END_OF_FILE) {
+            nextToken();
         }
-        case TokenType::STRING: {
-            return std::make_unique<StringLiteral>(currentToken.literal);
+        return false;
+    }
+    nesting++;
+    return true;
+}
+
+// How tightly each token type binds as an infix operator, indexed by
+// TokenType. Zero means the token does not continue an expression.
+struct InfixRule {
+    uint8_t precedence;
+    BinaryOperator op;
+};
+
+static constexpr size_t TOKEN_TYPE_COUNT = static_cast<size_t>(TokenType::END_OF_FILE) + 1;
+
+static constexpr std::array<InfixRule, TOKEN_TYPE_COUNT> makeInfixRules() {
+    std::array<InfixRule, TOKEN_TYPE_COUNT> rules{};
+    rules[static_cast<size_t>(TokenType::PLUS)] = {1, BinaryOperator::ADD};
+    rules[static_cast<size_t>(TokenType::MINUS)] = {1, BinaryOperator::SUBTRACT};
+    rules[static_cast<size_t>(TokenType::STAR)] = {2, BinaryOperator::MULTIPLY};
+    rules[static_cast<size_t>(TokenType::SLASH)] = {2, BinaryOperator::DIVIDE};
+    return rules;
+}
+
+static constexpr std::array<InfixRule, TOKEN_TYPE_COUNT> INFIX_RULES = makeInfixRules();
+
+// Past this many levels of parentheses, call arguments and right operands
+// an expression is parsed on explicit stacks instead of by recursion
+static constexpr size_t EXPRESSION_RECURSION_LIMIT = 1024;
+
+// Starts on the expression's first token and ends on its last, like every
+// other parse method
+Expression* Parser::parseExpression() {
+    return parseExpression(0, 0);
+}
+
+// Precedence climbing by recursion, the cheapest way through ordinary
+// expressions: takes the operators that bind more tightly than
+// `precedence`. Left chains loop rather than recurse; only nesting goes
+// deeper, and past EXPRESSION_RECURSION_LIMIT the rest of the expression
+// goes to parseDeepExpression.
+Expression* Parser::parseExpression(uint8_t precedence, size_t depth) {
+    if (depth == EXPRESSION_RECURSION_LIMIT) {
+        return parseDeepExpression(precedence);
+    }
+    
+    Expression* left = parsePrimaryExpression(depth);
+    
+    while (true) {
+        const InfixRule& rule = INFIX_RULES[static_cast<size_t>(peekType())];
+        if (rule.precedence <= precedence) {
+            return left;
         }
-        case TokenType::IDENTIFIER: {
-            auto ident = std::make_unique<Identifier>(currentToken.literal);
+        nextToken();
+        nextToken();
+        Expression* right = parseExpression(rule.precedence, depth + 1);
+        left = makeBinary(left, rule.op, right);
+    }
+}
+
+Expression* Parser::parsePrimaryExpression(size_t depth) {
+    Expression* operand;
+    switch (startOperand(operand)) {
+        case OperandStart::COMPLETE:
+            return operand;
+        case OperandStart::CALL: {
+            size_t first = pendingArguments.size();
+            nextToken();
+            pendingArguments.push_back(parseExpression(0, depth + 1));
             
-            if (peekToken.type == TokenType::OPEN_PAREN) {
-                return parseCallExpression(std::move(ident));
+            while (peekType() == TokenType::COMMA) {
+                nextToken();
+                nextToken();
+                pendingArguments.push_back(parseExpression(0, depth + 1));
             }
-            
-            return ident;
+            return finishCall(operand, first);
         }
-        case TokenType::OPEN_PAREN: {
+        case OperandStart::GROUP: {
+            uint32_t start = tokenStart(current);
             nextToken();
-            auto expr = parseExpression();
+            return finishGroup(parseExpression(0, depth + 1), start);
+        }
+    }
+    return nullptr;
+}
+
+// Both expression parsers start operands here, so they build the same
+// nodes and report the same errors on either side of the recursion limit
+Parser::OperandStart Parser::startOperand(Expression*& operand) {
+    switch (currentType()) {
+        case TokenType::NUMBER:
+            operand = makeNode<NumberLiteral>(spanTo(tokenStart(current)), tokens.literal(current).real);
+            return OperandStart::COMPLETE;
+        case TokenType::INTEGER:
+            operand = makeNode<IntegerLiteral>(spanTo(tokenStart(current)), tokens.literal(current).integer);
+            return OperandStart::COMPLETE;
+        case TokenType::STRING:
+            operand = makeNode<StringLiteral>(spanTo(tokenStart(current)), arena->copyString(currentText()));
+            return OperandStart::COMPLETE;
+        case TokenType::IDENTIFIER:
+        case TokenType::PRINT: {
+            // print is reserved as a keyword but called like any other function
+            operand = makeNode<Identifier>(spanTo(tokenStart(current)), symbols().intern(currentText()));
             
-            if (!expectPeek(TokenType::CLOSE_PAREN)) {
-                return nullptr;
+            if (peekType() != TokenType::OPEN_PAREN) {
+                return OperandStart::COMPLETE;
             }
             
-            return expr;
+            nextToken(); // currentToken is now '('
+            if (peekType() == TokenType::CLOSE_PAREN) {
+                operand = finishCall(operand, pendingArguments.size());
+                return OperandStart::COMPLETE;
+            }
+            return OperandStart::CALL;
         }
+        case TokenType::OPEN_PAREN:
+            operand = nullptr;
+            return OperandStart::GROUP;
         default:
-            addError("Unexpected token: " + currentToken.literal);
-            return nullptr;
+            addError("Unexpected token: " + std::string(currentText()));
+            operand = nullptr;
+            return OperandStart::COMPLETE;
     }
 }
 
-std::unique_ptr<Expression> Parser::parseCallExpression(std::unique_ptr<Expression> function) {
-    auto call = std::make_unique<CallExpression>(std::move(function));
-    
-    nextToken(); // consume '('
-    
-    if (currentToken.type != TokenType::CLOSE_PAREN) {
-        call->arguments.push_back(parseExpression());
-        
-        while (peekToken.type == TokenType::COMMA) {
-            nextToken();
-            nextToken();
-            call->arguments.push_back(parseExpression());
-        }
-    }
-    
+Expression* Parser::finishCall(Expression* callee, size_t firstArgument) {
+    ArenaArray<Expression*> arguments = arena->copyArray(pendingArguments, firstArgument);
+    pendingArguments.resize(firstArgument);
+    return expectPeek(TokenType::CLOSE_PAREN) ? makeNode<CallExpression>(spanTo(callee->span().start), callee, arguments)
+                                              : nullptr;
+}
+
+Expression* Parser::finishGroup(Expression* grouped, uint32_t start) {
     if (!expectPeek(TokenType::CLOSE_PAREN)) {
         return nullptr;
     }
+    // Parentheses make no node; the grouped one covers them
+    if (grouped) {
+        grouped->setSpan(spanTo(start));
+    }
+    return grouped;
+}
+
+// The current token is the last one of the right operand
+Expression* Parser::makeBinary(Expression* left, BinaryOperator op, Expression* right) {
+    Expression* first = left ? left : right;
+    uint32_t start = first ? first->span().start : tokenStart(current);
+    return makeNode<BinaryExpression>(spanTo(start), left, op, right);
+}
+
+// Operator precedence parsing over explicit stacks, so nesting depth costs
+// heap, not native stack. Takes the operators that bind more tightly than
+// `precedence`, as parseExpression does.
+Expression* Parser::parseDeepExpression(uint8_t precedence) {
+    const size_t frameBase = frames.size();
     
-    return call;
+    while (true) {
+        Expression* operand;
+        switch (startOperand(operand)) {
+            case OperandStart::COMPLETE:
+                operands.push_back(operand);
+                break;
+            case OperandStart::CALL:
+                frames.push_back(ExpressionFrame{ExpressionFrame::CALL, 0, BinaryOperator::ADD, operand,
+                                                 pendingArguments.size(), 0});
+                nextToken();
+                continue;
+            case OperandStart::GROUP:
+                frames.push_back(ExpressionFrame{ExpressionFrame::GROUP, 0, BinaryOperator::ADD, nullptr, 0,
+                                                 tokenStart(current)});
+                nextToken();
+                continue;
+        }
+        
+        // An operand is complete. Whatever follows either extends it with
+        // an operator or closes the frames it sits in.
+        while (true) {
+            const InfixRule& rule = INFIX_RULES[static_cast<size_t>(peekType())];
+            if (rule.precedence > 0) {
+                // Left associative: equal precedence reduces first
+                reduce(frameBase, rule.precedence);
+                if (frames.size() == frameBase && rule.precedence <= precedence) {
+                    // The operator belongs to the expression around this one
+                    Expression* result = operands.back();
+                    operands.pop_back();
+                    return result;
+                }
+                frames.push_back(ExpressionFrame{ExpressionFrame::BINARY, rule.precedence, rule.op, nullptr, 0, 0});
+                nextToken();
+                nextToken();
+                break;
+            }
+            
+            reduce(frameBase, 1);
+            if (frames.size() == frameBase) {
+                Expression* result = operands.back();
+                operands.pop_back();
+                return result;
+            }
+            
+            if (frames.back().kind == ExpressionFrame::GROUP) {
+                uint32_t start = frames.back().start;
+                frames.pop_back();
+                operands.back() = finishGroup(operands.back(), start);
+                continue;
+            }
+            
+            // The operand is the call's latest argument
+            pendingArguments.push_back(operands.back());
+            operands.pop_back();
+            if (peekType() == TokenType::COMMA) {
+                nextToken();
+                nextToken();
+                break;
+            }
+            
+            Expression* callee = frames.back().callee;
+            size_t first = frames.back().firstArgument;
+            frames.pop_back();
+            operands.push_back(finishCall(callee, first));
+        }
+    }
 }
 
-int Parser::getOperatorPrecedence(TokenType type) {
-    switch (type) {
-        case TokenType::PLUS:
-        case TokenType::MINUS:
-            return 1;
-        case TokenType::STAR:
-        case TokenType::SLASH:
-            return 2;
-        default:
-            return 0;
+// Combine the pending binary operators, innermost first, that bind at
+// least as tightly as `precedence`, stopping at the first group or call
+void Parser::reduce(size_t frameBase, uint8_t precedence) {
+    while (frames.size() > frameBase && frames.back().kind == ExpressionFrame::BINARY &&
+           frames.back().precedence >= precedence) {
+        BinaryOperator op = frames.back().op;
+        frames.pop_back();
+        Expression* right = operands.back();
+        operands.pop_back();
+        operands.back() = makeBinary(operands.back(), op, right);
     }
-}
\ No newline at end of file
+}
@@ -1,37 +1,113 @@
 #pragma once
 #include "lexer.h"
 #include "ast.h"
+#include "source.h"
 #include <memory>
 
 class Parser {
 private:
-    Lexer lexer;
-    Token currentToken;
-    Token peekToken;
+    TokenStream tokens;
+    size_t current;  // index of the current token in `tokens`
+    StreamingLexer* stream;  // non-null when `tokens` is a sliding window
+    Arena* arena;  // the arena of the Program being parsed
+    size_t nodeCount;  // nodes allocated so far, excluding the Program
+    uint32_t base;  // SourceMap offset of the input's first byte
+    uint32_t windowBase;  // SourceMap offset of tokens.source[0]; moves as a stream slides
+    size_t nesting;  // blocks and else-ifs open around the current token
+    
+    template <typename T, typename... Args>
+    T* makeNode(SourceSpan span, Args&&... args) {
+        nodeCount++;
+        T* node = arena->make<T>(std::forward<Args>(args)...);
+        node->setSpan(span);
+        return node;
+    }
+    
+    // Where token i starts and ends as SourceMap offsets. Streaming windows
+    // forget their consumed tokens, so spans record a node's start offset
+    // while its first token is current, never a token index.
+    uint32_t tokenStart(size_t i) const { return windowBase + tokens.offsets[i]; }
+    uint32_t tokenEnd(size_t i) const;
+    // From `start` through the end of the current token
+    SourceSpan spanTo(uint32_t start) const { return SourceSpan{start, tokenEnd(current) - start}; }
+    
+    // Children collected so far for the lists being parsed. Nested lists
+    // push above their parent's entries and copy their own range into the
+    // arena once complete, so no list needs a heap allocation of its own.
+    std::vector<Statement*> pendingStatements;
+    std::vector<Expression*> pendingArguments;
+    std::vector<Symbol> pendingParameters;
+    
+    // parseDeepExpression never recurses. Finished operands wait on
+    // `operands`; `frames` holds, innermost last, the binary operators still
+    // waiting for their right operand and the parentheses and calls they
+    // sit inside.
+    struct ExpressionFrame {
+        enum Kind : uint8_t { BINARY, GROUP, CALL } kind;
+        uint8_t precedence;  // BINARY
+        BinaryOperator op;  // BINARY
+        Expression* callee;  // CALL
+        size_t firstArgument;  // CALL: its arguments start here in pendingArguments
+        uint32_t start;  // GROUP: offset of the '('
+    };
+    std::vector<Expression*> operands;
+    std::vector<ExpressionFrame> frames;
+    
+    // Tokens kept buffered ahead of the current one when streaming
+    static constexpr size_t STREAM_LOOKAHEAD = 4;
     
     void nextToken();
+    TokenType currentType() const { return tokens.types[current]; }
+    std::string_view currentText() const { return tokens.text(current); }
+    // Type of the token `distance` places ahead; END_OF_FILE past the end
+    TokenType peekType(size_t distance = 1) const {
+        size_t index = current + distance;
+        return index < tokens.size() ? tokens.types[index] : TokenType::END_OF_FILE;
+    }
     bool expectPeek(TokenType type);
     
     // Parsing methods
-    std::unique_ptr<Statement> parseStatement();
-    std::unique_ptr<LetStatement> parseLetStatement();
-    std::unique_ptr<FunctionDeclaration> parseFunctionDeclaration();
-    std::unique_ptr<OnClickStatement> parseOnClickStatement();
-    std::unique_ptr<ExpressionStatement> parseExpressionStatement();
-    std::unique_ptr<BlockStatement> parseBlockStatement();
+    Statement* parseStatement();
+    LetStatement* parseLetStatement();
+    FunctionDeclaration* parseFunctionDeclaration();
+    OnClickStatement* parseOnClickStatement();
+    ReturnStatement* parseReturnStatement();
+    IfStatement* parseIfStatement();
+    ExpressionStatement* parseExpressionStatement();
+    BlockStatement* parseBlockStatement();
+    // Counts one more level of statement nesting, or reports it too deep
+    // and gives up on the rest of the input
+    bool enterNested();
     
-    std::unique_ptr<Expression> parseExpression(int precedence = 0);
-    std::unique_ptr<Expression> parsePrimaryExpression();
-    std::unique_ptr<Expression> parseCallExpression(std::unique_ptr<Expression> function);
+    Expression* parseExpression();
+    Expression* parseExpression(uint8_t precedence, size_t depth);
+    Expression* parsePrimaryExpression(size_t depth);
+    Expression* parseDeepExpression(uint8_t precedence);
+    void reduce(size_t frameBase, uint8_t precedence);
     
-    int getOperatorPrecedence(TokenType type);
+    // An operand starting at the current token: a literal, identifier,
+    // argument-less call or error comes back whole in `operand`. A call
+    // with arguments (`operand` is its callee) or a parenthesized group is
+    // left open with the current token on its '('.
+    enum class OperandStart : uint8_t { COMPLETE, CALL, GROUP };
+    OperandStart startOperand(Expression*& operand);
+    // Close a call whose arguments are pendingArguments from
+    // `firstArgument` on, or a group opened at `start`; the next token
+    // must be ')'. Either gives nullptr if it is not.
+    Expression* finishCall(Expression* callee, size_t firstArgument);
+    Expression* finishGroup(Expression* grouped, uint32_t start);
+    Expression* makeBinary(Expression* left, BinaryOperator op, Expression* right);
     
 public:
-    Parser(const std::string& input);
+    // `base` places the input in a SourceMap; node spans are offset by it
+    Parser(std::string_view input, uint32_t base = 0);
+    Parser(TokenStream tokens, uint32_t base = 0);
+    Parser(StreamingLexer& stream, uint32_t base = 0);
     std::unique_ptr<Program> parseProgram();
     std::vector<std::string> getErrors() const { return errors; }
     
 private:
     std::vector<std::string> errors;
+    std::unique_ptr<LineIndex> lineIndex;  // built on the first error
     void addError(const std::string& message);
 };
\ No newline at end of file
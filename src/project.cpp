@@ -0,0 +1,125 @@
+#include "project.h"
+#include "parser.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace fs = std::filesystem;
+
+bool collectSources(const std::vector<std::string>& inputs, std::vector<std::string>& paths) {
+    for (const std::string& input : inputs) {
+        std::error_code error;
+        if (input == "-" || !fs::is_directory(input, error)) {
+            paths.push_back(input);
+            continue;
+        }
+        std::vector<std::string> scripts;
+        for (fs::directory_iterator it(input, error), end; !error && it != end; it.increment(error)) {
+            if (it->path().extension() == ".ks" && it->is_regular_file(error)) {
+                scripts.push_back(it->path().string());
+            }
+        }
+        if (error) {
+            std::cerr << "Error: Could not list directory '" << input << "': " << error.message() << std::endl;
+            return false;
+        }
+        std::sort(scripts.begin(), scripts.end());
+        paths.insert(paths.end(), scripts.begin(), scripts.end());
+    }
+    return true;
+}
+
+bool readManifest(const std::string& manifest, std::vector<std::string>& paths) {
+    std::ifstream in(manifest);
+    if (!in) {
+        std::cerr << "Error: Could not open manifest '" << manifest << "': " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    fs::path base = fs::path(manifest).parent_path();
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        size_t end = line.find_last_not_of(" \t\r");
+        fs::path path = line.substr(start, end - start + 1);
+        paths.push_back(path.is_absolute() ? path.string() : (base / path).string());
+    }
+    return true;
+}
+
+static void parseFile(SourceFile& file, unsigned worker) {
+    if (!file.errors.empty()) {
+        return;  // not loaded
+    }
+    auto start = std::chrono::steady_clock::now();
+    file.worker = worker;
+    Parser parser(file.source.view(), file.base);
+    file.program = parser.parseProgram();
+    file.errors = parser.getErrors();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    file.milliseconds = elapsed.count();
+}
+
+void parseFiles(std::vector<SourceFile>& files, SourceMap& sources, unsigned threads) {
+    for (SourceFile& file : files) {
+        if (!file.source.loadFile(file.path)) {
+            file.errors.push_back(std::string("Could not open file: ") + std::strerror(errno));
+            continue;
+        }
+        file.base = sources.add(file.path, static_cast<uint32_t>(file.source.size()), file.source.view());
+    }
+    
+    if (threads == 0) {
+        threads = ThreadPool::hardwareThreads();
+    }
+    threads = std::min<size_t>(threads, files.size());
+    if (threads <= 1) {
+        for (SourceFile& file : files) {
+            parseFile(file, 0);
+        }
+        return;
+    }
+
+    // Largest first, so one big file queued last cannot leave every other
+    // worker idle while it is parsed
+    std::vector<size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return files[a].source.size() > files[b].source.size(); });
+
+    ThreadPool pool(threads);
+    for (size_t index : order) {
+        SourceFile* file = &files[index];
+        pool.submit([file](unsigned worker) { parseFile(*file, worker); });
+    }
+    pool.wait();
+}
+
+std::unique_ptr<Program> mergePrograms(const std::vector<SourceFile>& files) {
+    auto merged = std::make_unique<Program>();
+    std::vector<Statement*> statements;
+    std::vector<const FlatAST*> flats;
+    size_t nodeCount = 1;
+    for (const SourceFile& file : files) {
+        if (!file.program) continue;
+        statements.insert(statements.end(), file.program->statements.begin(), file.program->statements.end());
+        flats.push_back(&file.program->flat);
+        nodeCount += file.program->nodeCount - 1;
+    }
+    merged->statements = merged->arena.copyArray(statements);
+    merged->nodeCount = nodeCount;
+    // Each file's flat AST was built on its worker; joining them is a copy
+    // rather than a second walk over every tree
+    merged->flat = FlatAST::concatenate(flats);
+    merged->setSpan(merged->flat.span(merged->flat.root));
+    return merged;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "ast.h"
+#include "source.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One script of a multi-file build and what parsing it produced
+struct SourceFile {
+    std::string path;
+    SourceBuffer source;
+    std::unique_ptr<Program> program;  // null if the file could not be read
+    std::vector<std::string> errors;  // read or parse errors
+    uint32_t base = 0;  // SourceMap offset of the file's first byte
+    double milliseconds = 0;  // lex and parse
+    unsigned worker = 0;  // the pool worker that parsed it
+};
+
+/**
+ * Expands command-line inputs into script paths, in a fixed order: a
+ * directory contributes the .ks files directly inside it, sorted by name,
+ * and any other input is taken as given. Returns false, after reporting
+ * on stderr, if a directory cannot be listed.
+ */
+bool collectSources(const std::vector<std::string>& inputs, std::vector<std::string>& paths);
+
+// Appends the paths a manifest lists, one per line, relative to the
+// manifest's own directory. Blank lines and lines starting with # are
+// skipped. Returns false, after reporting on stderr, if it cannot be read.
+bool readManifest(const std::string& manifest, std::vector<std::string>& paths);
+
+/**
+ * Loads every file and adds it to `sources`, in `files` order, then lexes
+ * and parses them on a pool of `threads` workers (one per hardware thread
+ * when 0). Loading up front gives each file its SourceMap base before any
+ * node is made; it is cheap next to parsing, as loads are mostly mmaps.
+ * Each file is parsed on its own, so results do not depend on which
+ * worker finished first.
+ */
+void parseFiles(std::vector<SourceFile>& files, SourceMap& sources, unsigned threads = 0);
+
+/**
+ * One Program running every file's top-level statements (declarations,
+ * lets, onClick registrations), file by file in `files` order. The merged
+ * Program holds pointers into each file's Program, so `files` must outlive
+ * it. Files without a Program contribute nothing.
+ */
+std::unique_ptr<Program> mergePrograms(const std::vector<SourceFile>& files);
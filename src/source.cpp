@@ -0,0 +1,208 @@
+#include "source.h"
+#include "charscan.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void SourceBuffer::release() {
+    if (mapped) {
+        munmap(const_cast<char*>(mapped), mappedLength);
+        mapped = nullptr;
+        mappedLength = 0;
+    }
+    owned.clear();
+}
+
+bool SourceBuffer::readAll(int fd) {
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n == 0) {
+            return true;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        owned.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+bool SourceBuffer::loadFile(const std::string& path) {
+    release();
+    
+    if (path == "-") {
+        return readAll(STDIN_FILENO);
+    }
+    
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size_t length = static_cast<size_t>(st.st_size);
+        void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, length, MADV_SEQUENTIAL);
+            mapped = static_cast<const char*>(addr);
+            mappedLength = length;
+            close(fd);
+            return true;
+        }
+    }
+    
+    // Not mappable (pipe, FIFO, character device, empty file): read it instead.
+    bool ok = readAll(fd);
+    int savedErrno = errno;
+    close(fd);
+    errno = savedErrno;
+    return ok;
+}
+
+void SourceBuffer::assign(std::string text) {
+    release();
+    owned = std::move(text);
+}
+
+LineIndex::LineIndex(std::string_view source) {
+    const CharScanner& scan = charScanner();
+    size_t newlines = scan.countNewlines(source.data(), source.length());
+    
+    // Line 1 starts at 0; every other line starts one past a newline.
+    lineStarts.resize(newlines + 1);
+    lineStarts[0] = 0;
+    scan.collectNewlines(source.data(), source.length(), 1, lineStarts.data() + 1);
+}
+
+SourcePosition LineIndex::locate(uint32_t offset) const {
+    auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    size_t line = static_cast<size_t>(it - lineStarts.begin());
+    return {static_cast<int>(line), static_cast<int>(offset - lineStarts[line - 1]) + 1};
+}
+
+uint32_t SourceMap::add(std::string name, uint32_t size, std::string_view text, bool copyText) {
+    Script script;
+    script.name = std::move(name);
+    script.base = nextBase;
+    script.size = size;
+    if (copyText) {
+        script.copy.assign(text);
+    } else {
+        script.text = text;
+    }
+    scripts.push_back(std::move(script));
+    // One offset past the end stays inside the script, for spans that end
+    // at end of input
+    nextBase += size + 1;
+    return scripts.back().base;
+}
+
+std::string SourceMap::describe(uint32_t offset) {
+    auto it = std::upper_bound(scripts.begin(), scripts.end(), offset,
+                               [](uint32_t value, const Script& script) { return value < script.base; });
+    if (it == scripts.begin()) {
+        return "";
+    }
+    Script& script = *--it;
+    uint32_t local = offset - script.base;
+    if (local > script.size) {
+        return "";
+    }
+    if (!script.lines) {
+        std::string_view text = script.copy.empty() ? script.text : std::string_view(script.copy);
+        if (text.empty() && script.size > 0) {
+            // Stdin cannot be read back, and a file may have changed since
+            if (script.reloaded) {
+                return script.name;  // tried before
+            }
+            script.reloaded = std::make_unique<SourceBuffer>();
+            if (script.name == "-" || !script.reloaded->loadFile(script.name) ||
+                script.reloaded->size() < script.size) {
+                return script.name;
+            }
+            text = script.reloaded->view().substr(0, script.size);
+        }
+        script.lines = std::make_unique<LineIndex>(text);
+    }
+    SourcePosition pos = script.lines->locate(local);
+    return script.name + ":" + std::to_string(pos.line) + ":" + std::to_string(pos.column);
+}
+
+ChunkedSource::ChunkedSource(size_t chunkSize)
+    : fd(-1), ownsFd(false), eof(true), chunkSize(chunkSize > 0 ? chunkSize : 1),
+      windowStart{1, 1}, windowOffset(0), bytesRead(0), peakWindow(0) {}
+
+ChunkedSource::~ChunkedSource() {
+    if (ownsFd) {
+        close(fd);
+    }
+}
+
+bool ChunkedSource::open(const std::string& path) {
+    if (path == "-") {
+        fd = STDIN_FILENO;
+        ownsFd = false;
+    } else {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        ownsFd = true;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    eof = false;
+    return true;
+}
+
+void ChunkedSource::discard(size_t count) {
+    const CharScanner& scan = charScanner();
+    size_t newlines = scan.countNewlines(window.data(), count);
+    if (newlines == 0) {
+        windowStart.column += static_cast<int>(count);
+    } else {
+        size_t lastNewline = window.rfind('\n', count - 1);
+        windowStart.line += static_cast<int>(newlines);
+        windowStart.column = static_cast<int>(count - lastNewline);
+    }
+    window.erase(0, count);
+    windowOffset += count;
+}
+
+bool ChunkedSource::readChunk() {
+    if (eof) {
+        return true;
+    }
+    
+    size_t used = window.size();
+    window.resize(used + chunkSize);
+    ssize_t n;
+    do {
+        n = read(fd, &window[used], chunkSize);
+    } while (n < 0 && errno == EINTR);
+    
+    window.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
+    if (n < 0) {
+        return false;
+    }
+    if (n == 0) {
+        eof = true;
+    }
+    
+    bytesRead += static_cast<size_t>(n);
+    peakWindow = std::max(peakWindow, window.size());
+    return true;
+}
+
+SourcePosition ChunkedSource::locate(uint32_t offset) const {
+    size_t newlines = charScanner().countNewlines(window.data(), offset);
+    if (newlines == 0) {
+        return {windowStart.line, windowStart.column + static_cast<int>(offset)};
+    }
+    size_t lastNewline = window.rfind('\n', offset - 1);
+    return {windowStart.line + static_cast<int>(newlines), static_cast<int>(offset - lastNewline)};
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct SourcePosition {
+    int line;    // 1-based
+    int column;  // 1-based, in bytes
+};
+
+// The bytes a node was parsed from. `start` is a SourceMap offset, so one
+// number names both the file and the place in it.
+struct SourceSpan {
+    uint32_t start;
+    uint32_t length;
+};
+/**
+ * SourceBuffer owns the text of one script. Regular files are memory-mapped
+ * read-only so the lexer scans the mapped pages directly; pipes, stdin and
+ * anything else that cannot be mapped fall back to read() into a string.
+ */
+class SourceBuffer {
+private:
+    const char* mapped;
+    size_t mappedLength;
+    std::string owned;
+
+    void release();
+    bool readAll(int fd);
+
+public:
+    SourceBuffer() : mapped(nullptr), mappedLength(0) {}
+    ~SourceBuffer() { release(); }
+    
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    
+    // Load a file ("-" means stdin). On failure returns false with errno set.
+    bool loadFile(const std::string& path);
+    void assign(std::string text);
+    
+    std::string_view view() const {
+        return mapped ? std::string_view(mapped, mappedLength) : std::string_view(owned);
+    }
+    size_t size() const { return view().size(); }
+    bool isMapped() const { return mapped != nullptr; }
+};
+
+
+/**
+ * LineIndex maps byte offsets to line/column. Tokens only carry offsets; the
+ * index is built once per source, when a position is first needed, with a
+ * vectorized newline scan, and each lookup is a binary search.
+ */
+class LineIndex {
+private:
+    std::vector<uint32_t> lineStarts;  // offset of the first byte of each line
+
+public:
+    explicit LineIndex(std::string_view source);
+    SourcePosition locate(uint32_t offset) const;
+    size_t lineCount() const { return lineStarts.size(); }
+};
+
+/**
+ * SourceMap gives every script of a run its own range of offsets, one after
+ * another, the way a linker lays out sections. The parser adds a script's
+ * base to every span it records, so a span found anywhere later (a merged
+ * multi-file program, an interactive line's handler) still says which
+ * script it came from. Line starts are only indexed for scripts that a
+ * location is actually asked of.
+ */
+class SourceMap {
+private:
+    struct Script {
+        std::string name;
+        uint32_t base;
+        uint32_t size;
+        std::string_view text;  // empty when the text was not kept (streamed)
+        std::string copy;  // the text, for scripts added with a copy
+        std::unique_ptr<SourceBuffer> reloaded;  // a streamed script read back
+        std::unique_ptr<LineIndex> lines;
+    };
+    std::vector<Script> scripts;  // ascending base
+    uint32_t nextBase;
+
+public:
+    SourceMap() : nextBase(0) {}
+
+    // Reserves `size` offsets for a script and returns its base. `text`, if
+    // given, must outlive the map unless `copyText` is set; without it, the
+    // script is read back from `name` when first located.
+    uint32_t add(std::string name, uint32_t size, std::string_view text = {}, bool copyText = false);
+    // "name:line:column" for an offset, or "" if no script holds it
+    std::string describe(uint32_t offset);
+};
+
+/**
+ * ChunkedSource reads a file descriptor in fixed-size chunks into a sliding
+ * window, for lexing inputs that should never be held in memory whole. The
+ * window only grows past one chunk by the bytes the caller still needs
+ * (an unfinished token), so memory stays bounded by the chunk size.
+ */
+class ChunkedSource {
+private:
+    int fd;
+    bool ownsFd;
+    bool eof;
+    size_t chunkSize;
+    std::string window;
+    SourcePosition windowStart;  // line/column of window[0]
+    size_t windowOffset;  // input offset of window[0]
+    size_t bytesRead;
+    size_t peakWindow;
+
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+    
+    explicit ChunkedSource(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    ~ChunkedSource();
+    
+    ChunkedSource(const ChunkedSource&) = delete;
+    ChunkedSource& operator=(const ChunkedSource&) = delete;
+    
+    // Open a file ("-" means stdin). On failure returns false with errno set.
+    bool open(const std::string& path);
+    // Forget the first `count` bytes of the window.
+    void discard(size_t count);
+    // Append up to one chunk to the window. Returns false on a read error.
+    bool readChunk();
+    
+    std::string_view view() const { return window; }
+    bool atEnd() const { return eof; }
+    // Line/column of a window offset, counted from the start of the input
+    SourcePosition locate(uint32_t offset) const;
+    // Bytes discarded so far: add to a window offset for an input offset
+    size_t discardedBytes() const { return windowOffset; }
+    size_t totalBytes() const { return bytesRead; }
+    size_t peakWindowSize() const { return peakWindow; }
+};
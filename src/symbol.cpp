@@ -0,0 +1,97 @@
+#include "symbol.h"
+
+SymbolTable::SymbolTable() : next(0) {
+    for (Shard& shard : shards) {
+        shard.slots.assign(64, Slot{0, NO_SYMBOL, std::string_view()});
+    }
+    for (auto& segment : segments) {
+        segment.store(nullptr, std::memory_order_relaxed);
+    }
+    intern("print");
+}
+
+SymbolTable::~SymbolTable() {
+    for (auto& segment : segments) {
+        delete[] segment.load(std::memory_order_relaxed);
+    }
+}
+
+// FNV-1a; names are short, so a simple byte loop is enough
+uint32_t SymbolTable::hash(std::string_view name) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) {
+        h = (h ^ c) * 16777619u;
+    }
+    return h;
+}
+
+// Index of the slot holding `name`, or of the empty slot where it belongs.
+// The low bits of the hash pick the slot; the top ones picked the shard.
+size_t SymbolTable::probe(const Shard& shard, std::string_view name, uint32_t h) {
+    size_t mask = shard.slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        const Slot& slot = shard.slots[i];
+        if (slot.symbol == NO_SYMBOL || (slot.hash == h && slot.name == name)) {
+            return i;
+        }
+    }
+}
+
+void SymbolTable::rehash(Shard& shard) {
+    std::vector<Slot> old(shard.slots.size() * 2, Slot{0, NO_SYMBOL, std::string_view()});
+    old.swap(shard.slots);
+    size_t mask = shard.slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.symbol == NO_SYMBOL) continue;
+        size_t i = slot.hash & mask;
+        while (shard.slots[i].symbol != NO_SYMBOL) {
+            i = (i + 1) & mask;
+        }
+        shard.slots[i] = slot;
+    }
+}
+
+Symbol SymbolTable::intern(std::string_view name) {
+    uint32_t h = hash(name);
+    Shard& shard = shardFor(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    size_t index = probe(shard, name, h);
+    if (shard.slots[index].symbol != NO_SYMBOL) {
+        return shard.slots[index].symbol;
+    }
+
+    std::string_view copy = shard.storage.copyString(name);
+    Symbol symbol = next.fetch_add(1, std::memory_order_relaxed);
+    size_t offset;
+    std::atomic<std::string_view*>& segment = segments[segmentOf(symbol, offset)];
+    std::string_view* names = segment.load(std::memory_order_acquire);
+    if (!names) {
+        // The first Symbol of a segment to be interned allocates it, unless
+        // another shard's thread got there first
+        std::string_view* fresh = new std::string_view[FIRST_SEGMENT << (&segment - segments)];
+        if (segment.compare_exchange_strong(names, fresh, std::memory_order_acq_rel)) {
+            names = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    names[offset] = copy;
+
+    shard.slots[index] = Slot{h, symbol, copy};
+    if (++shard.count * 2 > shard.slots.size()) {
+        rehash(shard);
+    }
+    return symbol;
+}
+
+Symbol SymbolTable::find(std::string_view name) const {
+    uint32_t h = hash(name);
+    Shard& shard = shardFor(h);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.slots[probe(shard, name, h)].symbol;
+}
+
+SymbolTable& symbols() {
+    static SymbolTable table;
+    return table;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "arena.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Interned name. Two names are equal exactly when their Symbols are.
+using Symbol = uint32_t;
+
+constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+// Symbols interned up front, in this order, so the interpreter can test for
+// them without a lookup
+constexpr Symbol SYMBOL_PRINT = 0;
+
+/**
+ * SymbolTable interns identifiers, binding names and event ids to dense
+ * integer ids at parse time. Interned text lives in the table's own arenas
+ * and is never freed, so a Symbol stays valid for the life of the process.
+ * Lookup is an open-addressed table of (hash, symbol, name) slots, so a
+ * probe only touches the name text when the full hashes match.
+ *
+ * intern() and find() may be called from several threads at once (files
+ * are parsed in parallel). The table is split into shards by the top bits
+ * of the hash, each with its own lock, slots and arena, so threads only
+ * wait for each other when they intern names of the same shard at once.
+ * Symbols are still numbered in one sequence, from an atomic counter, and
+ * names are kept by Symbol in segments that never move. name() and size()
+ * take no lock and must not race with intern(); they are used once parsing
+ * is over.
+ */
+class SymbolTable {
+private:
+    struct Slot {
+        uint32_t hash;
+        Symbol symbol;  // NO_SYMBOL when empty
+        std::string_view name;
+    };
+
+    // 64-byte aligned, so two shards' locks never share a cache line
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Arena storage;
+        std::vector<Slot> slots;  // power-of-two size, at most half full
+        size_t count = 0;
+    };
+
+    static constexpr unsigned SHARD_BITS = 4;
+    // Segment k holds the names of FIRST_SEGMENT << k Symbols, following
+    // those of the segments before it
+    static constexpr size_t FIRST_SEGMENT = 1024;
+    static constexpr size_t SEGMENTS = 32;
+
+    mutable Shard shards[1 << SHARD_BITS];
+    std::atomic<Symbol> next;
+    std::atomic<std::string_view*> segments[SEGMENTS];
+
+    static uint32_t hash(std::string_view name);
+    static size_t probe(const Shard& shard, std::string_view name, uint32_t h);
+    static void rehash(Shard& shard);
+    Shard& shardFor(uint32_t h) const { return shards[h >> (32 - SHARD_BITS)]; }
+
+    // The segment holding `symbol`'s name and its index there
+    static size_t segmentOf(Symbol symbol, size_t& offset) {
+        size_t blocks = symbol / FIRST_SEGMENT + 1;
+        size_t k = 63 - static_cast<size_t>(__builtin_clzll(blocks));
+        offset = symbol - FIRST_SEGMENT * ((size_t(1) << k) - 1);
+        return k;
+    }
+
+public:
+    SymbolTable();
+    ~SymbolTable();
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    Symbol intern(std::string_view name);
+    // The symbol for `name`, or NO_SYMBOL if it was never interned
+    Symbol find(std::string_view name) const;
+    std::string_view name(Symbol symbol) const {
+        size_t offset;
+        size_t k = segmentOf(symbol, offset);
+        return segments[k].load(std::memory_order_relaxed)[offset];
+    }
+    size_t size() const { return next.load(std::memory_order_relaxed); }
+};
+
+// The process-wide table used by the parser and interpreter
+SymbolTable& symbols();
@@ -0,0 +1,62 @@
+#include "thread_pool.h"
+
+unsigned ThreadPool::hardwareThreads() {
+    // hardware_concurrency() may report 0 when it cannot tell
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+ThreadPool::ThreadPool(unsigned threads) : running(0), stopping(false) {
+    if (threads == 0) {
+        threads = hardwareThreads();
+    }
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return queue.empty() && running == 0; });
+}
+
+// Queued tasks are drained before a stopping worker exits
+void ThreadPool::work(unsigned worker) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        Task task = std::move(queue.front());
+        queue.pop_front();
+        running++;
+        lock.unlock();
+        task(worker);
+        lock.lock();
+        running--;
+        if (queue.empty() && running == 0) {
+            idle.notify_all();
+        }
+    }
+}
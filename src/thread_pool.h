@@ -0,0 +1,45 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * ThreadPool runs submitted tasks on a fixed set of worker threads, in
+ * submission order as workers come free. Each task is told which worker
+ * runs it (0 .. size()-1), for per-worker scratch and for reporting.
+ * Tasks must not throw. The destructor waits for every submitted task.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void(unsigned worker)>;
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<Task> queue;
+    std::mutex mutex;
+    std::condition_variable wake;  // a task was queued, or the pool is stopping
+    std::condition_variable idle;  // the last running task finished
+    size_t running;
+    bool stopping;
+
+    void work(unsigned worker);
+
+public:
+    // One worker per hardware thread when `threads` is 0
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+    // Blocks until the queue is empty and no task is running
+    void wait();
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    static unsigned hardwareThreads();
+};
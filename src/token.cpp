@@ -3,6 +3,7 @@
 std::string tokenTypeToString(TokenType type) {
     switch (type) {
         case TokenType::NUMBER: return "NUMBER";
+        case TokenType::INTEGER: return "INTEGER";
         case TokenType::IDENTIFIER: return "IDENTIFIER";
         case TokenType::STRING: return "STRING";
         case TokenType::PRINT: return "PRINT";
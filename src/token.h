@@ -1,12 +1,15 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 /**
  * TokenType enum defines all the different types of tokens our lexer can recognize.
  */
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Literals
-    NUMBER,
+    NUMBER,      // real literal: 1.5, 2.
+    INTEGER,     // integer literal that fits in int64_t: 42
     IDENTIFIER,
     STRING,
     
@@ -40,14 +43,107 @@ enum class TokenType {
     END_OF_FILE
 };
 
+// Decoded value of a NUMBER (real) or INTEGER (integer) token
+union LiteralValue {
+    double real;
+    int64_t integer;
+};
+
+/**
+ * Token is a cheap value type: `literal` is a view into the source buffer the
+ * lexer was constructed over (or, for strings containing escapes, into the
+ * lexer's decoded-string storage). It must not outlive either of them.
+ * `offset` is the byte offset of the token's first character (the opening
+ * quote for strings); LineIndex turns it into a line and column on demand.
+ * Numeric tokens are decoded once by the lexer and carry their `value`.
+ */
 struct Token {
     TokenType type;
-    std::string literal;
-    int line;
-    int column;
+    std::string_view literal;
+    uint32_t offset;
+    LiteralValue value;
     
-    Token(TokenType t, std::string l, int ln = 1, int col = 1) 
-        : type(t), literal(l), line(ln), column(col) {}
+    Token(TokenType t, std::string_view l, uint32_t off = 0, LiteralValue v = {0.0}) 
+        : type(t), literal(l), offset(off), value(v) {}
+};
+
+std::string tokenTypeToString(TokenType type);
+
+/**
+ * Keyword recognition uses a perfect hash generated at compile time, so
+ * classifying an identifier costs one multiply and at most one string compare.
+ *
+ * To add a keyword, append it to KEYWORDS. keywordSeed() searches for a
+ * multiplier that maps every keyword to its own slot; if the table ever gets
+ * too crowded the static_assert below fires and KEYWORD_TABLE_BITS needs bumping.
+ */
+struct Keyword {
+    std::string_view text;
+    TokenType type;
 };
 
-std::string tokenTypeToString(TokenType type);
\ No newline at end of file
+inline constexpr Keyword KEYWORDS[] = {
+    {"let", TokenType::LET},
+    {"print", TokenType::PRINT},
+    {"function", TokenType::FUNCTION},
+    {"if", TokenType::IF},
+    {"else", TokenType::ELSE},
+    {"while", TokenType::WHILE},
+    {"return", TokenType::RETURN},
+    {"onClick", TokenType::ONCLICK}
+};
+
+inline constexpr unsigned KEYWORD_TABLE_BITS = 4;
+inline constexpr size_t KEYWORD_TABLE_SIZE = size_t(1) << KEYWORD_TABLE_BITS;
+
+constexpr uint32_t keywordHash(std::string_view word, uint32_t seed) {
+    uint32_t key = static_cast<uint32_t>(word.size()) << 16
+                 | static_cast<uint32_t>(static_cast<unsigned char>(word.front())) << 8
+                 | static_cast<uint32_t>(static_cast<unsigned char>(word.back()));
+    return (key * seed) >> (32 - KEYWORD_TABLE_BITS);
+}
+
+constexpr uint32_t keywordSeed() {
+    for (uint32_t seed = 0x9E3779B1u; seed != 0x9E3779B1u + 100000u; seed += 2) {
+        bool used[KEYWORD_TABLE_SIZE] = {};
+        bool collision = false;
+        for (const Keyword& kw : KEYWORDS) {
+            uint32_t slot = keywordHash(kw.text, seed);
+            if (used[slot]) {
+                collision = true;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (!collision) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+inline constexpr uint32_t KEYWORD_SEED = keywordSeed();
+static_assert(KEYWORD_SEED != 0, "no perfect hash found for KEYWORDS; increase KEYWORD_TABLE_BITS");
+
+struct KeywordTable {
+    Keyword slots[KEYWORD_TABLE_SIZE];
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table = {};
+    for (size_t i = 0; i < KEYWORD_TABLE_SIZE; i++) {
+        table.slots[i] = {std::string_view(), TokenType::IDENTIFIER};
+    }
+    for (const Keyword& kw : KEYWORDS) {
+        table.slots[keywordHash(kw.text, KEYWORD_SEED)] = kw;
+    }
+    return table;
+}
+
+inline constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+
+// Returns the keyword's token type, or IDENTIFIER. `word` must be non-empty.
+inline TokenType lookupKeyword(std::string_view word) {
+    const Keyword& slot = KEYWORD_TABLE.slots[keywordHash(word, KEYWORD_SEED)];
+    return slot.text == word ? slot.type : TokenType::IDENTIFIER;
+}
@@ -0,0 +1,169 @@
+#include "value.h"
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Strings up to this long are interned when made at run time. Longer
+// ones are rarely repeated, so hashing them would rarely save anything.
+static constexpr size_t INTERN_LENGTH = 16;
+
+/**
+ * Interned strings, open-addressed by hash with linear probing as in the
+ * SymbolTable, so interning allocates nothing but the string itself. A
+ * string leaves when its last Value goes, and the entries probed past it
+ * shift back into its place, so no tombstones build up.
+ */
+class InternTable {
+private:
+    std::vector<StringObject*> slots;  // power-of-two size, at most half full; null when empty
+    size_t count;
+
+    void grow() {
+        std::vector<StringObject*> old(slots.size() * 2, nullptr);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (StringObject* string : old) {
+            if (!string) continue;
+            size_t i = string->hash & mask;
+            while (slots[i]) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = string;
+        }
+    }
+
+public:
+    InternTable() : slots(1024, nullptr), count(0) {}
+
+    // FNV-1a, as for symbols: interned strings are short
+    static uint32_t hash(std::string_view text) {
+        uint32_t h = 2166136261u;
+        for (unsigned char c : text) {
+            h = (h ^ c) * 16777619u;
+        }
+        return h;
+    }
+
+    // The slot holding `text`, or the empty slot where it belongs
+    StringObject*& find(std::string_view text, uint32_t h) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            StringObject* string = slots[i];
+            if (!string || (string->hash == h && string->view() == text)) {
+                return slots[i];
+            }
+        }
+    }
+
+    // Make room for one more before find()ing the slot to add it in
+    void reserveOne() {
+        if (++count * 2 > slots.size()) {
+            grow();
+        }
+    }
+
+    void erase(const StringObject* string) {
+        size_t mask = slots.size() - 1;
+        size_t hole = string->hash & mask;
+        while (slots[hole] != string) {
+            hole = (hole + 1) & mask;
+        }
+        // Move back each later entry of the run that may not sit past the hole
+        for (size_t i = (hole + 1) & mask; slots[i]; i = (i + 1) & mask) {
+            size_t home = slots[i]->hash & mask;
+            bool reachable = hole <= i ? home > hole && home <= i : home > hole || home <= i;
+            if (!reachable) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = nullptr;
+        count--;
+    }
+};
+
+// Never destroyed, so Values dropped during static destruction can still
+// leave it
+static InternTable& internTable() {
+    static InternTable* table = new InternTable();
+    return *table;
+}
+
+static StringObject* allocateString(size_t length) {
+    void* memory = ::operator new(offsetof(StringObject, chars) + length + 1);
+    StringObject* string = static_cast<StringObject*>(memory);
+    string->header.refs = 1;
+    string->length = static_cast<uint32_t>(length);
+    string->interned = false;
+    string->chars[length] = '\0';
+    return string;
+}
+
+// An empty view may have no data pointer, which memcpy must not be given
+static char* append(char* to, std::string_view text) {
+    if (!text.empty()) {
+        std::memcpy(to, text.data(), text.size());
+    }
+    return to + text.size();
+}
+
+static StringObject* intern(std::string_view text) {
+    InternTable& table = internTable();
+    uint32_t hash = InternTable::hash(text);
+    StringObject* found = table.find(text, hash);
+    if (found) {
+        found->header.refs++;
+        return found;
+    }
+    table.reserveOne();
+    StringObject* string = allocateString(text.size());
+    append(string->chars, text);
+    string->hash = hash;
+    string->interned = true;
+    table.find(text, hash) = string;
+    return string;
+}
+
+Value Value::literal(std::string_view text) {
+    return Value(STRING, intern(text));
+}
+
+Value Value::string(std::string_view text) {
+    if (text.size() <= INTERN_LENGTH) {
+        return literal(text);
+    }
+    StringObject* string = allocateString(text.size());
+    append(string->chars, text);
+    return Value(STRING, string);
+}
+
+Value Value::concatenate(std::string_view left, std::string_view right) {
+    size_t length = left.size() + right.size();
+    if (length <= INTERN_LENGTH) {
+        char joined[INTERN_LENGTH];
+        append(append(joined, left), right);
+        return literal(std::string_view(joined, length));
+    }
+    StringObject* string = allocateString(length);
+    append(append(string->chars, left), right);
+    return Value(STRING, string);
+}
+
+uint64_t Value::wideInteger(int64_t value) {
+    IntegerObject* integer = new IntegerObject;
+    integer->header.refs = 1;
+    integer->value = value;
+    return boxed(WIDE_INTEGER, reinterpret_cast<uint64_t>(integer));
+}
+
+void Value::destroy() {
+    if (tag() == STRING) {
+        StringObject* string = reinterpret_cast<StringObject*>(object());
+        if (string->interned) {
+            internTable().erase(string);
+        }
+        ::operator delete(string);
+    } else {
+        delete reinterpret_cast<IntegerObject*>(object());
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// First member of each heap part of a Value: a string, or an integer too
+// wide to box inline. Counts are not atomic: Values are made and dropped on
+// the thread that optimizes and runs the program, never shared between
+// threads.
+struct Object {
+    uint32_t refs;
+};
+
+// Immutable once made. `chars` holds `length` bytes and a '\0'.
+struct StringObject {
+    Object header;
+    uint32_t length;
+    uint32_t hash;  // set when interned
+    bool interned;
+    char chars[1];
+
+    std::string_view view() const { return std::string_view(chars, length); }
+};
+
+struct IntegerObject {
+    Object header;
+    int64_t value;
+};
+
+/**
+ * Value types that our interpreter can handle, in 8 bytes. Integer
+ * literals stay integers through + - * (and exact /) so counters and
+ * indexes never lose precision; anything that overflows or mixes with a
+ * double becomes a double.
+ *
+ * A double is stored as itself. Every other value is a NaN no arithmetic
+ * produces: the sign, exponent and quiet bits set, a 3-bit tag below them
+ * and a 48-bit payload. A NaN result keeps its sign, which prints, but
+ * loses the quiet bit, so it never collides. Integers that fit in 48 bits
+ * and bools are the payload; strings and wider integers point to a
+ * reference-counted Object, so copying any Value never allocates.
+ *
+ * Strings made from literals, and short ones made at run time, are
+ * interned: equal text is one object. An interned string leaves the table
+ * when its last Value goes.
+ */
+class Value {
+private:
+    static_assert(sizeof(void*) == 8, "objects are boxed as 48-bit pointers");
+
+    enum Tag : uint64_t {
+        INTEGER = 1,
+        BOOLEAN = 2,
+        STRING = 4,        // tags with this bit set point to an Object
+        WIDE_INTEGER = 5,
+    };
+
+    static constexpr uint64_t BOXED = 0xFFF8000000000000;
+    static constexpr int TAG_SHIFT = 48;
+    static constexpr uint64_t PAYLOAD = (uint64_t(1) << TAG_SHIFT) - 1;
+    static constexpr uint64_t OBJECT = BOXED | uint64_t(STRING) << TAG_SHIFT;
+    static constexpr uint64_t SIGN = uint64_t(1) << 63;
+    static constexpr uint64_t NAN_BITS = 0x7FF4000000000000;  // signalling, outside the boxed space
+    static constexpr int64_t MAX_INLINE = (int64_t(1) << (TAG_SHIFT - 1)) - 1;
+    static constexpr int64_t MIN_INLINE = -MAX_INLINE - 1;
+
+    uint64_t bits;
+
+    static constexpr uint64_t boxed(Tag tag, uint64_t payload) { return BOXED | uint64_t(tag) << TAG_SHIFT | payload; }
+    Tag tag() const { return static_cast<Tag>((bits >> TAG_SHIFT) & 7); }
+    bool isBoxed() const { return (bits & BOXED) == BOXED; }
+    bool isObject() const { return (bits & OBJECT) == OBJECT; }
+    Object* object() const { return reinterpret_cast<Object*>(bits & PAYLOAD); }
+
+    explicit Value(Tag tag, const void* object) : bits(boxed(tag, reinterpret_cast<uint64_t>(object))) {}
+    void retain() const { object()->refs++; }
+    void release() {
+        if (--object()->refs == 0) {
+            destroy();
+        }
+    }
+    void destroy();
+    static uint64_t wideInteger(int64_t value);
+
+public:
+    Value() : bits(0) {}  // 0.0
+    Value(double value) {
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (value != value) {
+            bits = (bits & SIGN) | NAN_BITS;
+        }
+    }
+    Value(int64_t value)
+        : bits(value >= MIN_INLINE && value <= MAX_INLINE ? boxed(INTEGER, static_cast<uint64_t>(value) & PAYLOAD)
+                                                           : wideInteger(value)) {}
+    Value(bool value) : bits(boxed(BOOLEAN, value)) {}
+    // Would otherwise convert to bool
+    Value(const char*) = delete;
+
+    // A string holding `text`, shared with any equal one if it is short
+    static Value string(std::string_view text);
+    // `left` then `right` as one string, with a single allocation
+    static Value concatenate(std::string_view left, std::string_view right);
+    // A string for a literal in the program: always interned
+    static Value literal(std::string_view text);
+
+    Value(const Value& other) : bits(other.bits) {
+        if (isObject()) retain();
+    }
+    Value(Value&& other) noexcept : bits(other.bits) { other.bits = 0; }
+    Value& operator=(const Value& other) {
+        if (other.isObject()) other.retain();
+        if (isObject()) release();
+        bits = other.bits;
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            if (isObject()) release();
+            bits = other.bits;
+            other.bits = 0;
+        }
+        return *this;
+    }
+    ~Value() {
+        if (isObject()) release();
+    }
+
+    bool isDouble() const { return !isBoxed(); }
+    bool isInteger() const { return isBoxed() && (tag() == INTEGER || tag() == WIDE_INTEGER); }
+    bool isBoolean() const { return isBoxed() && tag() == BOOLEAN; }
+    bool isString() const { return isBoxed() && tag() == STRING; }
+    // An integer in the payload itself; wide ones are not
+    bool isInlineInteger() const { return (bits & (BOXED | uint64_t(7) << TAG_SHIFT)) == boxed(INTEGER, 0); }
+
+    double asDouble() const {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    int64_t asInlineInteger() const { return static_cast<int64_t>(bits << (64 - TAG_SHIFT)) >> (64 - TAG_SHIFT); }
+    int64_t asInteger() const {
+        return tag() == INTEGER ? asInlineInteger() : reinterpret_cast<const IntegerObject*>(object())->value;
+    }
+    bool asBoolean() const { return bits & 1; }
+    const StringObject& asString() const { return *reinterpret_cast<const StringObject*>(object()); }
+};